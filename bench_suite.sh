@@ -0,0 +1,70 @@
+#!/bin/bash
+# Regression suite: builds stencil_bench.cpp against every kernel variant below
+# and appends all runs to one CSV, labelled with the commit and the date, so
+# that throughput, accuracy and synthesis results can be compared across runs.
+# A variant gets the csynth_design report of run_hls.tcl / compare_engines.tcl
+# that was synthesized with its settings, when that project exists.
+#
+#   ./bench_suite.sh [csv] [stencil_bench arguments, e.g. --repetitions 3]
+#
+# Environment: HLS_INCLUDE (default $XILINX_HLS/include), CXX (default g++),
+# BUILD (default bench_build), LABEL (default <commit>-<date>).
+
+cd "$(dirname "$0")"
+
+CSV=${1:-bench_results.csv}
+shift
+HLS_INCLUDE=${HLS_INCLUDE:-$XILINX_HLS/include}
+CXX=${CXX:-g++}
+BUILD=${BUILD:-bench_build}
+LABEL=${LABEL:-$(git rev-parse --short HEAD 2>/dev/null || echo local)-$(date +%Y%m%d)}
+
+# name | kernel | -D flags | csynth reports (first one found is used)
+RUN_HLS_REPORT=cong_stencil_project_2/solution1/syn/report/csynth.xml
+VARIANTS=(
+    "stream|cong_no_lcs.cpp|-DBENCH_TARGET=1|"
+    "chain_p1|first_try_cong.cpp|-DPARALLEL_FACTOR=1|$RUN_HLS_REPORT cong_stencil_chain/solution1/syn/report/csynth.xml"
+    "linebuffer_p1|first_try_cong.cpp|-DPARALLEL_FACTOR=1 -DSTENCIL_ENGINE=1|cong_stencil_linebuffer/solution1/syn/report/csynth.xml"
+    "chain_p4|first_try_cong.cpp|-DPARALLEL_FACTOR=4|"
+    "chain_p16|first_try_cong.cpp|-DPARALLEL_FACTOR=16|"
+    "fixed_p4|first_try_cong.cpp|-DPARALLEL_FACTOR=4 -DDATA_FORMAT=1|"
+    "half_p4|first_try_cong.cpp|-DPARALLEL_FACTOR=4 -DDATA_FORMAT=2|"
+    "bfloat16_p4|first_try_cong.cpp|-DPARALLEL_FACTOR=4 -DDATA_FORMAT=3|"
+    "shape9_p1|first_try_cong.cpp|-DSTENCIL_SHAPE=9|"
+    "shape13_p1|first_try_cong.cpp|-DSTENCIL_SHAPE=13|"
+    "shape6_p1|first_try_cong.cpp|-DSTENCIL_SHAPE=6|"
+    "steps2_p4|first_try_cong.cpp|-DPARALLEL_FACTOR=4 -DTIME_STEPS=2|"
+)
+
+mkdir -p "$BUILD"
+failed=""
+for variant in "${VARIANTS[@]}"; do
+    IFS='|' read -r name kernel flags reports <<< "$variant"
+    echo "=== $name: $kernel $flags"
+
+    if ! $CXX -std=c++14 -O2 -I "$HLS_INCLUDE" -I . $flags "$kernel" stencil_bench.cpp \
+            -o "$BUILD/stencil_bench_$name"; then
+        failed="$failed $name(build)"
+        continue
+    fi
+
+    csynth=()
+    for report in $reports; do
+        if [ -f "$report" ]; then
+            csynth=(--csynth "$report")
+            break
+        fi
+    done
+
+    if ! "$BUILD/stencil_bench_$name" --csv "$CSV" --label "$LABEL" "${csynth[@]}" "$@"; then
+        failed="$failed $name"
+    fi
+done
+
+echo ""
+if [ -z "$failed" ]; then
+    echo "--- SUITE PASSED: ${#VARIANTS[@]} variants appended to $CSV ---"
+else
+    echo "--- SUITE FAILED:$failed ---"
+    exit 1
+fi
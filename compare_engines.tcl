@@ -0,0 +1,57 @@
+# Side-by-side synthesis + co-simulation of the two stencil engines
+# (STENCIL_ENGINE in first_try_cong.cpp). Creates one project per engine:
+#   cong_stencil_chain       splitter/filter chain of Figure 5 (411)
+#   cong_stencil_linebuffer  single line-buffer process with a 3x3 window
+# and prints a resource/latency table from the csynth reports at the end.
+#
+#vitis-run --mode hls --tcl compare_engines.tcl
+
+set ENGINES {chain 0 linebuffer 1}
+
+# Reads one value out of csynth.xml (first match of <tag>value</tag>)
+proc report_value {xml tag} {
+    if {[regexp "<$tag>(\[^<\]*)</$tag>" $xml -> value]} {
+        return $value
+    }
+    return "-"
+}
+
+foreach {name engine} $ENGINES {
+    open_project -reset cong_stencil_$name
+    set CFLAGS "-DPARALLEL_FACTOR=1 -DSTENCIL_ENGINE=$engine"
+    add_files first_try_cong.cpp -cflags $CFLAGS
+    add_files -tb cong_testbench.cpp -cflags $CFLAGS
+    set_top architecture_top_level
+
+    # Same solution settings as run_hls.tcl
+    open_solution -flow_target vitis -reset "solution1"
+    set_part {xczu7ev-ffvc1156-2-e}
+    create_clock -period 4.5 -name default
+    config_compile -pipeline_loops 0
+    config_compile -unsafe_math_optimizations
+    config_storage fifo -impl lutram
+
+    csynth_design
+    cosim_design -enable_dataflow_profiling
+    close_project
+}
+
+puts ""
+puts [format "%-12s %10s %10s %10s %10s %10s %14s" engine BRAM_18K URAM DSP FF LUT latency(cyc)]
+foreach {name engine} $ENGINES {
+    set fp [open cong_stencil_$name/solution1/syn/report/csynth.xml r]
+    set xml [read $fp]
+    close $fp
+    regexp {<AreaEstimates>.*</AreaEstimates>} $xml area
+    puts [format "%-12s %10s %10s %10s %10s %10s %14s" $name \
+        [report_value $area BRAM_18K] [report_value $area URAM] [report_value $area DSP] \
+        [report_value $area FF] [report_value $area LUT] \
+        [report_value $xml Worst-caseLatency]]
+}
+puts ""
+puts "Co-simulation latency per engine:"
+foreach {name engine} $ENGINES {
+    puts "  cong_stencil_$name/solution1/sim/report/architecture_top_level_cosim.rpt"
+}
+
+exit
@@ -0,0 +1,266 @@
+#include "ap_int.h"
+#include "hls_stream.h"
+
+// 3D version of the splitter/filter/FIFO network of first_try_cong.cpp for
+// volumes A[k][i][j] (planes x rows x columns, row-major, j fastest), streamed
+// once from DRAM at one voxel per clock. B[k][i][j] is the sum of the squared
+// differences between A[k][i][j] and its six neighbours A[k][i][j±1],
+// A[k][i±1][j] and A[k±1][i][j], on the interior (planes-2) x (rows-2) x (columns-2).
+
+#include "csim_dataflow.h"
+#include "stencil_chain.h"
+
+typedef float data_t;
+const int DATA_WIDTH = 32;
+
+// The volume size is a runtime argument (planes, rows, columns) of the top level.
+// MAX_ROWS x MAX_COLUMNS sizes the plane FIFOs, MAX_COLUMNS the row FIFOs and
+// MAX_PLANES only bounds the trip counts.
+// Valid runtime sizes: 3 <= planes <= MAX_PLANES, 3 <= rows <= MAX_ROWS,
+// 3 <= columns <= MAX_COLUMNS.
+const int MAX_PLANES = 64;
+const int MAX_ROWS = 64;
+const int MAX_COLUMNS = 256;
+const int MAX_PLANE_ELEMENTS = MAX_ROWS * MAX_COLUMNS;
+const int MAX_TOTAL_ELEMENTS = MAX_PLANES * MAX_PLANE_ELEMENTS;
+const int MAX_KERNEL_ITERATIONS = (MAX_PLANES - 2) * (MAX_ROWS - 2) * (MAX_COLUMNS - 2);
+
+// --- STENCIL DESCRIPTION ---
+// A 3D stencil is a constexpr list of offsets (dk, di, dj), as stencil_points
+// in first_try_cong.cpp with the plane offset in front
+template <int... OFFSETS>
+struct stencil_points_3d {
+    static const int size = sizeof...(OFFSETS) / 3;
+
+    static constexpr int value(int n) {
+        const int offsets[] = {OFFSETS...};
+        return offsets[n];
+    }
+    static constexpr int dk(int p) { return value(3 * p); }
+    static constexpr int di(int p) { return value(3 * p + 1); }
+    static constexpr int dj(int p) { return value(3 * p + 2); }
+};
+
+// j-1, j+1, i-1, i+1, k-1, k+1 as res_0..res_5, centre last
+typedef stencil_points_3d<0,0,-1,  0,0,1,  0,-1,0,  0,1,0,  -1,0,0,  1,0,0,  0,0,0> seven_point_stencil;
+
+// The halo is one voxel on every side
+const int HALO = 1;
+
+// --- CORE LOGIC MODULES ---
+
+void data_splitter(hls::stream<data_t>& in,
+                   hls::stream<data_t>& out_to_fifo,
+                   hls::stream<data_t>& out_to_filter,
+                   int planes, int rows, int columns) { //FIG 5 (411)
+
+    int total_elements = planes * rows * columns;
+    for (int n = 0; n < total_elements; n++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_ELEMENTS
+        data_t temp = in.read();
+        out_to_fifo.write(temp);
+        out_to_filter.write(temp);
+    }
+}
+
+// The domain D_Ax of a filter is planes DK+HALO..planes-1-HALO+DK, rows
+// DI+HALO..rows-1-HALO+DI and columns DJ+HALO..columns-1-HALO+DJ: the voxels
+// A[k+dk][i+di][j+dj] of every B[k][i][j]. The plane/row/column loops are
+// flattened by hand, as in the 2D filter.
+template <int DK, int DI, int DJ>
+void data_filter(hls::stream<data_t>& in,
+                 hls::stream<data_t>& out,
+                 int planes, int rows, int columns) { //FIG 5 (411)
+
+    int total_elements = planes * rows * columns;
+    int k = 0;
+    int i = 0;
+    int j = 0;
+
+    for (int n = 0; n < total_elements; n++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_ELEMENTS
+        data_t data_in = in.read();
+
+        bool in_domain = (k >= HALO + DK && k <= planes - 1 - HALO + DK &&
+                          i >= HALO + DI && i <= rows - 1 - HALO + DI &&
+                          j >= HALO + DJ && j <= columns - 1 - HALO + DJ);
+
+        if (in_domain) {
+            out.write(data_in);
+        }
+
+        if (j == columns - 1) {
+            j = 0;
+            if (i == rows - 1) {
+                i = 0;
+                k++;
+            } else {
+                i++;
+            }
+        } else {
+            j++;
+        }
+    }
+}
+
+// taps[p] carries A[k+dk(p)][i+di(p)][j+dj(p)] for every output B[k][i][j], in
+// output order. Calculations as in Listing 1 (408), with the plane neighbours.
+template <class Points>
+void compute_kernel(hls::stream<data_t> taps[Points::size],
+                    hls::stream<data_t>& out_B,
+                    int planes, int rows, int columns) {
+
+    const int N = Points::size;
+    int centre = 0;
+    for (int p = 0; p < N; p++) {
+        if (Points::dk(p) == 0 && Points::di(p) == 0 && Points::dj(p) == 0) centre = p;
+    }
+
+    int kernel_iterations = (planes - 2 * HALO) * (rows - 2 * HALO) * (columns - 2 * HALO);
+    for (int n = 0; n < kernel_iterations; n++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_KERNEL_ITERATIONS
+
+        // Reading the needed inputs
+        data_t a[N];
+        for (int p = 0; p < N; p++) {
+            #pragma HLS UNROLL
+            a[p] = taps[p].read();
+        }
+
+        data_t b_val = 0;
+        for (int p = 0; p < N; p++) {
+            #pragma HLS UNROLL
+            if (p != centre) {
+                data_t res = a[centre] - a[p];
+                b_val += res * res;
+            }
+        }
+
+        out_B.write(b_val);
+    }
+}
+
+void last_splitter_emptying(hls::stream<data_t>& in, int planes, int rows, int columns) {
+    int total_elements = planes * rows * columns;
+    for (int n = 0; n < total_elements; n++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_ELEMENTS
+        in.read();
+    }
+}
+
+// --- STENCIL GENERATOR ---
+// The chain of Figure 5 (411) is built by stencil_chain.h, as in
+// first_try_cong.cpp, with the linear offset dk*MAX_PLANE_ELEMENTS +
+// di*MAX_COLUMNS + dj and one voxel per element. For the 7-point stencil that
+// gives two plane FIFOs (k+1 -> i+1 and i-1 -> k-1, a plane minus a row), two
+// row FIFOs (i+1 -> j+1 and j-1 -> i-1, a row minus a voxel) and two FIFOs of
+// one voxel around the centre; the plane FIFOs go to URAM.
+struct volume_chain {
+    typedef data_t element_t;
+    static const int ELEMENT_PIXELS = 1;
+    static const int ELEMENT_BITS = DATA_WIDTH;
+
+    template <class Points> static constexpr int linear_offset(int p) {
+        return Points::dk(p) * MAX_PLANE_ELEMENTS + Points::di(p) * MAX_COLUMNS + Points::dj(p);
+    }
+
+    // Splitter and filter of one stage
+    template <class Points, int STAGE>
+    static void tap(hls::stream<data_t>& in,
+                    hls::stream<data_t>& out_to_next,
+                    hls::stream<data_t> taps[Points::size],
+                    int planes, int rows, int columns) {
+        #pragma HLS INLINE
+        const int K = stencil_point_at_stage<volume_chain, Points>(STAGE);
+
+        hls::stream<data_t, 4> s_to_f(stencil_stage_names<STAGE>::s_to_f);
+        #pragma HLS STREAM variable=s_to_f depth=4
+
+        DATAFLOW_REGION;
+        DATAFLOW_PROCESS(data_splitter(in, out_to_next, s_to_f, planes, rows, columns));
+        DATAFLOW_PROCESS(data_filter<Points::dk(K), Points::di(K), Points::dj(K)>(
+                             s_to_f, taps[K], planes, rows, columns));
+    }
+
+    static void discard(hls::stream<data_t>& in, int planes, int rows, int columns) {
+        #pragma HLS INLINE
+        last_splitter_emptying(in, planes, rows, columns);
+    }
+};
+
+template <class Points> constexpr bool stencil_points_inside_halo() {
+    for (int p = 0; p < Points::size; p++) {
+        if (Points::dk(p) < -HALO || Points::dk(p) > HALO ||
+            Points::di(p) < -HALO || Points::di(p) > HALO ||
+            Points::dj(p) < -HALO || Points::dj(p) > HALO) return false;
+    }
+    return true;
+}
+
+template <class Points>
+void stencil_network(hls::stream<data_t>& A_in,
+                     hls::stream<data_t>& B_out,
+                     int planes, int rows, int columns) {
+    #pragma HLS INLINE
+    static_assert(stencil_points_distinct<volume_chain, Points>(), "stencil offsets must be distinct");
+    static_assert(stencil_points_inside_halo<Points>(), "the stencil has to fit a halo of HALO voxels");
+
+    hls::stream<data_t, 4> taps[Points::size];
+    #pragma HLS STREAM variable=taps depth=4
+    NAME_STREAMS(taps, "tap");
+
+    DATAFLOW_REGION;
+    DATAFLOW_PROCESS(stencil_stage<volume_chain, Points, 0>::run(A_in, taps, planes, rows, columns));
+    DATAFLOW_PROCESS(compute_kernel<Points>(taps, B_out, planes, rows, columns));
+}
+
+// --- LOAD / STORE ---
+void load_volume(data_t* in_mem, hls::stream<data_t>& in_stream, int planes, int rows, int columns) {
+    int total_elements = planes * rows * columns;
+    for (int n = 0; n < total_elements; n++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_ELEMENTS
+        in_stream.write(in_mem[n]);
+    }
+}
+
+void store_volume(hls::stream<data_t>& out_stream, data_t* out_mem, int planes, int rows, int columns) {
+    int kernel_iterations = (planes - 2 * HALO) * (rows - 2 * HALO) * (columns - 2 * HALO);
+    for (int n = 0; n < kernel_iterations; n++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_KERNEL_ITERATIONS
+        out_mem[n] = out_stream.read();
+    }
+}
+
+// --- TOP LEVEL ARCHITECTURE ---
+// A is a dense planes x rows x columns volume, B the dense
+// (planes-2) x (rows-2) x (columns-2) interior, both row-major.
+void architecture_top_level_3d(data_t* A_in_mem, data_t* B_out_mem,
+                               int planes, int rows, int columns) {
+
+    #pragma HLS INTERFACE m_axi port=A_in_mem bundle=gmem0 depth=MAX_TOTAL_ELEMENTS
+    #pragma HLS INTERFACE m_axi port=B_out_mem bundle=gmem1 depth=MAX_KERNEL_ITERATIONS
+    #pragma HLS INTERFACE s_axilite port=planes
+    #pragma HLS INTERFACE s_axilite port=rows
+    #pragma HLS INTERFACE s_axilite port=columns
+    #pragma HLS INTERFACE s_axilite port=return
+
+    #pragma HLS DATAFLOW
+    TOP_LEVEL_REGION;
+
+    hls::stream<data_t, 128> input_stream("input_stream");
+    #pragma HLS STREAM variable=input_stream depth=128
+
+    hls::stream<data_t, 128> output_stream("output_stream");
+    #pragma HLS STREAM variable=output_stream depth=128
+
+    DATAFLOW_REGION;
+    DATAFLOW_PROCESS(load_volume(A_in_mem, input_stream, planes, rows, columns));
+    DATAFLOW_PROCESS(stencil_network<seven_point_stencil>(input_stream, output_stream, planes, rows, columns));
+    DATAFLOW_PROCESS(store_volume(output_stream, B_out_mem, planes, rows, columns));
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "ap_int.h"
+#include "hls_stream.h"
+
+typedef float data_t;
+
+// Must match cong_3d.cpp
+const int MAX_PLANES = 64;
+const int MAX_ROWS = 64;
+const int MAX_COLUMNS = 256;
+
+// Volume sizes swept by the testbench (planes, rows, columns); all run on the same kernel
+const int NUM_TEST_SIZES = 6;
+const int TEST_SIZES[NUM_TEST_SIZES][3] = {
+    {3, 3, 3}, {4, 5, 7}, {8, 16, 33}, {5, MAX_ROWS, MAX_COLUMNS}, {MAX_PLANES, 3, 3}, {6, 9, 100}
+};
+
+// Neighbours (dk, di, dj) in the order of the kernel's seven_point_stencil, centre left out
+const int NUM_NEIGHBOURS = 6;
+const int NEIGHBOUR_OFFSETS[NUM_NEIGHBOURS][3] = {
+    {0, 0, -1}, {0, 0, 1}, {0, -1, 0}, {0, 1, 0}, {-1, 0, 0}, {1, 0, 0}
+};
+
+void architecture_top_level_3d(data_t* A_in_mem, data_t* B_out_mem,
+                               int planes, int rows, int columns);
+
+// B[k][i][j] = sum of (A[k][i][j] - A[k+dk][i+di][j+dj])^2 over the six
+// neighbours, summed in the kernel's order, on the interior of the volume
+void compute_golden_3d(const std::vector<data_t>& A, std::vector<data_t>& B,
+                       int planes, int rows, int columns) {
+    B.clear();
+    B.reserve((size_t)(planes - 2) * (rows - 2) * (columns - 2));
+    for (int k = 1; k < planes - 1; k++) {
+        for (int i = 1; i < rows - 1; i++) {
+            for (int j = 1; j < columns - 1; j++) {
+                float a000 = A[((size_t)k * rows + i) * columns + j];
+                float b_val = 0;
+                for (int p = 0; p < NUM_NEIGHBOURS; p++) {
+                    int kk = k + NEIGHBOUR_OFFSETS[p][0];
+                    int ii = i + NEIGHBOUR_OFFSETS[p][1];
+                    int jj = j + NEIGHBOUR_OFFSETS[p][2];
+                    float res = a000 - A[((size_t)kk * rows + ii) * columns + jj];
+                    b_val += res * res;
+                }
+                B.push_back(b_val);
+            }
+        }
+    }
+}
+
+// Runs one volume size through the kernel and returns the number of mismatches
+int run_test(int planes, int rows, int columns) {
+    int total_elements = planes * rows * columns;
+    int kernel_iterations = (planes - 2) * (rows - 2) * (columns - 2);
+
+    printf("[TB] Volume %d x %d x %d\n", planes, rows, columns);
+
+    // A ramp that is not periodic in a row or a plane, so that a voxel taken from
+    // the wrong neighbour shows up
+    std::vector<data_t> A(total_elements);
+    for (int n = 0; n < total_elements; n++) {
+        A[n] = (data_t)((n * 7) % 251);
+    }
+
+    std::vector<data_t> Golden;
+    compute_golden_3d(A, Golden, planes, rows, columns);
+
+    std::vector<data_t> B(kernel_iterations, 0);
+    architecture_top_level_3d(A.data(), B.data(), planes, rows, columns);
+
+    int errors = 0;
+    for (int n = 0; n < kernel_iterations; n++) {
+        if (std::abs((double)B[n] - (double)Golden[n]) > 1e-3 * std::max(1.0, std::abs((double)Golden[n]))) {
+            errors++;
+            if (errors < 10) {
+                printf("  [ERROR] n=%d HLS=%f Ref=%f\n", n, B[n], Golden[n]);
+            }
+        }
+    }
+    return errors;
+}
+
+int main() {
+    printf("[TB] Starting 3D Testbench...\n");
+
+    int errors = 0;
+    for (int t = 0; t < NUM_TEST_SIZES; t++) {
+        errors += run_test(TEST_SIZES[t][0], TEST_SIZES[t][1], TEST_SIZES[t][2]);
+    }
+
+    if (errors == 0) {
+        printf("\n--- TEST PASSED ---\n");
+        printf("All %d volume sizes match the golden reference\n", NUM_TEST_SIZES);
+    } else {
+        printf("\n--- TEST FAILED: %d errors ---\n", errors);
+    }
+
+    return (errors == 0) ? 0 : 1;
+}
@@ -3,68 +3,92 @@
 #include "ap_fixed.h" 
 #include "hls_stream.h"
 #include "hls_math.h"  
+#include "csim_dataflow.h"
 
 typedef float data_t;
 
-const int ROWS = 16;
-const int COLUMNS = 1024; //II A (408)
-const int TOTAL_ELEMENTS = ROWS * COLUMNS;
+// The grid size is a runtime argument (rows, columns) of the top level.
+// MAX_COLUMNS sizes the line-buffer FIFOs; nothing is sized by the height, so
+// MAX_ROWS only sets the trip counts of the reports.
+// Valid runtime sizes: 3 <= rows, 3 <= columns <= MAX_COLUMNS.
+const int MAX_ROWS = 16;
+const int MAX_COLUMNS = 1024; //II A (408)
+const int MAX_TOTAL_ELEMENTS = MAX_ROWS * MAX_COLUMNS;
 
-const int FIFO_0_DEPTH = 1023;
+const int FIFO_0_DEPTH = MAX_COLUMNS - 1;
 const int FIFO_1_DEPTH = 4;
 const int FIFO_2_DEPTH = 4;
-const int FIFO_3_DEPTH = 1023; //TABLE 3 (413)
+const int FIFO_3_DEPTH = MAX_COLUMNS - 1; //TABLE 3 (413)
 
-const int KERNEL_ROWS = ROWS - 2; // 0+1 til 767-1 instead of 0-768
-const int KERNEL_COLUMNS = COLUMNS - 2; // 0+1 til 1023-1 instead of 0-1024
-const int KERNEL_ITERATIONS = KERNEL_ROWS * KERNEL_COLUMNS;
+const int MAX_KERNEL_ROWS = MAX_ROWS - 2; // 0+1 til rows-1-1 instead of 0-rows
+const int MAX_KERNEL_COLUMNS = MAX_COLUMNS - 2; // 0+1 til columns-1-1 instead of 0-columns
+const int MAX_KERNEL_ITERATIONS = MAX_KERNEL_ROWS * MAX_KERNEL_COLUMNS;
 
-template <int T_TOTAL_ELEMENTS>
 void data_splitter(hls::stream<data_t> &in,
                    hls::stream<data_t> &out_to_fifo,
-                   hls::stream<data_t> &out_to_filter) { //FIG 5 (411)
+                   hls::stream<data_t> &out_to_filter,
+                   int rows, int columns) { //FIG 5 (411)
 
-
-    for (int i = 0; i < T_TOTAL_ELEMENTS; i++) {
+    int total_elements = rows * columns;
+    for (int i = 0; i < total_elements; i++) {
         #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_ELEMENTS
         data_t temp = in.read();
         out_to_fifo.write(temp);
         out_to_filter.write(temp);
     }
 }
 
-template <int T_ROWS, int T_COLUMNS,
-          int T_ROW_START, int T_ROW_END,
-          int T_COL_START, int T_COL_END>
+// The domain D_Ax of a filter is rows T_ROW_START..rows-1-T_ROW_END_MARGIN and
+// columns T_COL_START..columns-1-T_COL_END_MARGIN, so it follows the runtime size.
+// The row/column loops are flattened by hand: with runtime bounds a pipelined
+// inner loop would lose cycles at every row change.
+template <int T_ROW_START, int T_ROW_END_MARGIN,
+          int T_COL_START, int T_COL_END_MARGIN>
 void data_filter(hls::stream<data_t>& in,
-                 hls::stream<data_t>& out) { //FIG 5 (411)
+                 hls::stream<data_t>& out,
+                 int rows, int columns) { //FIG 5 (411)
+
+    int total_elements = rows * columns;
+    int row_end = rows - 1 - T_ROW_END_MARGIN;
+    int col_end = columns - 1 - T_COL_END_MARGIN;
+    int i = 0;
+    int j = 0;
 
-    for (int i = 0; i < T_ROWS; i++) {
-        for (int j = 0; j < T_COLUMNS; j++) {
-            #pragma HLS PIPELINE II=1
-            data_t data_in = in.read();
+    for (int n = 0; n < total_elements; n++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_ELEMENTS
+        data_t data_in = in.read();
 
-            // Έλεγχος αν το (i, j) ανήκει στο D_Ax αυτού του φίλτρου
-            bool in_domain = (i >= T_ROW_START && i <= T_ROW_END &&
-                              j >= T_COL_START && j <= T_COL_END);
+        // Έλεγχος αν το (i, j) ανήκει στο D_Ax αυτού του φίλτρου
+        bool in_domain = (i >= T_ROW_START && i <= row_end &&
+                          j >= T_COL_START && j <= col_end);
+
+        if (in_domain) {
+            out.write(data_in);
+        }
 
-            if (in_domain) {
-                out.write(data_in);
-            }
+        if (j == columns - 1) {
+            j = 0;
+            i++;
+        } else {
+            j++;
         }
     }
 }
 
-template <int T_ITERATIONS>
 void compute_kernel(hls::stream<data_t>& in_1, // A[i+1][j]
                     hls::stream<data_t>& in_2, // A[i][j+1]
                     hls::stream<data_t>& in_3, // A[i][j]
                     hls::stream<data_t>& in_4, // A[i][j-1]
                     hls::stream<data_t>& in_5, // A[i-1][j]
-                    hls::stream<data_t>& out_B) {
+                    hls::stream<data_t>& out_B,
+                    int rows, int columns) {
 
-    for (int i = 0; i < T_ITERATIONS; i++) {
+    int kernel_iterations = (rows - 2) * (columns - 2);
+    for (int i = 0; i < kernel_iterations; i++) {
         #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_KERNEL_ITERATIONS
 
         // Reading the needed inputs
         data_t a10 = in_1.read(); //+1 0
@@ -86,34 +110,44 @@ void compute_kernel(hls::stream<data_t>& in_1, // A[i+1][j]
     }
 }
 
-template <int T_TOTAL_ELEMENTS>
-void last_splitter_emptying(hls::stream<data_t>& in) { //Needed so that the daata forwarded from last splitter to non-existent FIFO is emptied
-    for (int i = 0; i < T_TOTAL_ELEMENTS; i++) {
+void last_splitter_emptying(hls::stream<data_t>& in, int rows, int columns) { //Needed so that the daata forwarded from last splitter to non-existent FIFO is emptied
+    int total_elements = rows * columns;
+    for (int i = 0; i < total_elements; i++) {
         #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_ELEMENTS
         in.read();
     }
 }
 
+// rows/columns select the frame size at runtime (see MAX_ROWS/MAX_COLUMNS).
 void architecture_top_level(hls::stream<data_t> &A_in,
-                         hls::stream<data_t> &B_out) {
+                         hls::stream<data_t> &B_out,
+                         int rows, int columns) {
+    #pragma HLS INTERFACE s_axilite port=rows
+    #pragma HLS INTERFACE s_axilite port=columns
+    #pragma HLS INTERFACE s_axilite port=return
     #pragma HLS DATAFLOW
+    TOP_LEVEL_REGION;
 
     // FIFO initialisation
-    hls::stream<data_t> fifo_0;
+    hls::stream<data_t, FIFO_0_DEPTH> fifo_0("fifo_0");
     #pragma HLS STREAM variable=fifo_0 depth=FIFO_0_DEPTH
     #pragma HLS BIND_STORAGE variable=fifo_0 type=fifo impl=bram
-    hls::stream<data_t> fifo_1;
+    hls::stream<data_t, FIFO_1_DEPTH> fifo_1("fifo_1");
     #pragma HLS STREAM variable=fifo_1 depth=FIFO_1_DEPTH
-    hls::stream<data_t> fifo_2;
+    hls::stream<data_t, FIFO_2_DEPTH> fifo_2("fifo_2");
     #pragma HLS STREAM variable=fifo_2 depth=FIFO_2_DEPTH
-    hls::stream<data_t> fifo_3;
+    hls::stream<data_t, FIFO_3_DEPTH> fifo_3("fifo_3");
     #pragma HLS STREAM variable=fifo_3 depth=FIFO_3_DEPTH
     #pragma HLS BIND_STORAGE variable=fifo_3 type=fifo impl=bram
 
     // Intermediate results
-    hls::stream<data_t> s0_to_f0, s1_to_f1, s2_to_f2, s3_to_f3, s4_to_f4;
-    hls::stream<data_t> f0_to_compute, f1_to_compute, f2_to_compute, f3_to_compute, f4_to_compute;
-    hls::stream<data_t> to_discard; // s4 out (not needed as described before)
+    hls::stream<data_t, 4> s0_to_f0("s0_to_f0"), s1_to_f1("s1_to_f1"), s2_to_f2("s2_to_f2"),
+                           s3_to_f3("s3_to_f3"), s4_to_f4("s4_to_f4");
+    hls::stream<data_t, 4> f0_to_compute("f0_to_compute"), f1_to_compute("f1_to_compute"),
+                           f2_to_compute("f2_to_compute"), f3_to_compute("f3_to_compute"),
+                           f4_to_compute("f4_to_compute");
+    hls::stream<data_t, 4> to_discard("to_discard"); // s4 out (not needed as described before)
 
     #pragma HLS STREAM variable=s0_to_f0 depth=4
     #pragma HLS STREAM variable=s1_to_f1 depth=4
@@ -127,31 +161,33 @@ void architecture_top_level(hls::stream<data_t> &A_in,
     #pragma HLS STREAM variable=f3_to_compute depth=4 
     #pragma HLS STREAM variable=f4_to_compute depth=4 
 
+    DATAFLOW_REGION;
 
     // All modules initialisation (Acc to Figure 5 (411))
-    // s0 and filter_0 (A[i+1][j]: i=2..767, j=1..1022)
-    data_splitter<TOTAL_ELEMENTS>(A_in, fifo_0, s0_to_f0);
-    data_filter<ROWS, COLUMNS, 2, ROWS-1, 1, COLUMNS-2>(s0_to_f0, f0_to_compute);
+    // s0 and filter_0 (A[i+1][j]: i=2..rows-1, j=1..columns-2)
+    DATAFLOW_PROCESS(data_splitter(A_in, fifo_0, s0_to_f0, rows, columns));
+    DATAFLOW_PROCESS(data_filter<2, 0, 1, 1>(s0_to_f0, f0_to_compute, rows, columns));
 
-    // s1 and filter_1 (A[i][j+1]: i=1..766, j=2..1023)
-    data_splitter<TOTAL_ELEMENTS>(fifo_0, fifo_1, s1_to_f1);
-    data_filter<ROWS, COLUMNS, 1, ROWS-2, 2, COLUMNS-1>(s1_to_f1, f1_to_compute);
+    // s1 and filter_1 (A[i][j+1]: i=1..rows-2, j=2..columns-1)
+    DATAFLOW_PROCESS(data_splitter(fifo_0, fifo_1, s1_to_f1, rows, columns));
+    DATAFLOW_PROCESS(data_filter<1, 1, 2, 0>(s1_to_f1, f1_to_compute, rows, columns));
 
-    // s2 and filter_2 (A[i][j]: i=1..766, j=1..1022)
-    data_splitter<TOTAL_ELEMENTS>(fifo_1, fifo_2, s2_to_f2);
-    data_filter<ROWS, COLUMNS, 1, ROWS-2, 1, COLUMNS-2>(s2_to_f2, f2_to_compute);
+    // s2 and filter_2 (A[i][j]: i=1..rows-2, j=1..columns-2)
+    DATAFLOW_PROCESS(data_splitter(fifo_1, fifo_2, s2_to_f2, rows, columns));
+    DATAFLOW_PROCESS(data_filter<1, 1, 1, 1>(s2_to_f2, f2_to_compute, rows, columns));
 
-    // s3 and filter_3 (A[i][j-1]: i=1..766, j=0..1021)
-    data_splitter<TOTAL_ELEMENTS>(fifo_2, fifo_3, s3_to_f3);
-    data_filter<ROWS, COLUMNS, 1, ROWS-2, 0, COLUMNS-3>(s3_to_f3, f3_to_compute);
+    // s3 and filter_3 (A[i][j-1]: i=1..rows-2, j=0..columns-3)
+    DATAFLOW_PROCESS(data_splitter(fifo_2, fifo_3, s3_to_f3, rows, columns));
+    DATAFLOW_PROCESS(data_filter<1, 1, 0, 2>(s3_to_f3, f3_to_compute, rows, columns));
 
-    // s4 and filter_4 (A[i-1][j]: i=0..765, j=1..1022)
-    data_splitter<TOTAL_ELEMENTS>(fifo_3, to_discard, s4_to_f4);
-    data_filter<ROWS, COLUMNS, 0, ROWS-3, 1, COLUMNS-2>(s4_to_f4, f4_to_compute);
+    // s4 and filter_4 (A[i-1][j]: i=0..rows-3, j=1..columns-2)
+    DATAFLOW_PROCESS(data_splitter(fifo_3, to_discard, s4_to_f4, rows, columns));
+    DATAFLOW_PROCESS(data_filter<0, 2, 1, 1>(s4_to_f4, f4_to_compute, rows, columns));
 
-    last_splitter_emptying<TOTAL_ELEMENTS>(to_discard);
+    DATAFLOW_PROCESS(last_splitter_emptying(to_discard, rows, columns));
 
     // Computation Kernel
-    compute_kernel<KERNEL_ITERATIONS>(
-        f0_to_compute, f1_to_compute, f2_to_compute, f3_to_compute, f4_to_compute, B_out);
+    DATAFLOW_PROCESS(compute_kernel(
+        f0_to_compute, f1_to_compute, f2_to_compute, f3_to_compute, f4_to_compute, B_out,
+        rows, columns));
 }
\ No newline at end of file
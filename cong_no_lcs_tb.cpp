@@ -1,89 +1,74 @@
 #include <stdio.h>   
+#include <vector>
 #include "ap_int.h"    
 #include "ap_fixed.h"   
 #include "hls_stream.h" 
 #include "hls_math.h" 
+#include "stencil_golden.h"
 
 typedef float data_t;
-const int ROWS = 16;
-const int COLUMNS = 1024;
-const int TOTAL_ELEMENTS = ROWS * COLUMNS;
-const int KERNEL_ROWS = ROWS - 2;
-const int KERNEL_COLUMNS = COLUMNS - 2;
-const int KERNEL_ITERATIONS = KERNEL_ROWS * KERNEL_COLUMNS;
+const int MAX_ROWS = 16;
+const int MAX_COLUMNS = 1024;
+
+// Μεγέθη πλαισίου που δοκιμάζονται (rows, columns) στο ίδιο kernel
+const int NUM_TEST_SIZES = 6;
+const int TEST_SIZES[NUM_TEST_SIZES][2] = {
+    {MAX_ROWS, MAX_COLUMNS}, {3, 3}, {5, 7}, {16, 513}, {9, 1000}, {12, 64}
+};
 
 void architecture_top_level(hls::stream<data_t>& A_in,
-                         hls::stream<data_t>& B_out);
+                         hls::stream<data_t>& B_out,
+                         int rows, int columns);
 
-void compute_golden(std::vector<data_t>& A_vec, std::vector<data_t>& B_golden_vec) {
+void compute_golden(std::vector<data_t>& A_vec, std::vector<data_t>& B_golden_vec,
+                    int rows, int columns) {
 
     printf("  [Golden] Starting golden computation...\n");
-    // Κάνουμε clear τον vector εξόδου για σιγουριά
-    B_golden_vec.clear();
-
-    // Οι βρόχοι του Listing 1 [cite: 55-59]
-    for (int i = 1; i < ROWS - 1; i++) {
-        for (int j = 1; j < COLUMNS - 1; j++) {
-            
-            // Μετατροπή 2D index σε 1D index
-            data_t a10  = A_vec[(i + 1) * COLUMNS + j]; // A[i+1][j]
-            data_t a01  = A_vec[i * COLUMNS + (j + 1)]; // A[i][j+1]
-            data_t a00  = A_vec[i * COLUMNS + j];       // A[i][j]
-            data_t a0m1 = A_vec[i * COLUMNS + (j - 1)]; // A[i][j-1]
-            data_t am10 = A_vec[(i - 1) * COLUMNS + j]; // A[i-1][j]
-
-            // Οι ίδιες πράξεις με το kernel
-            data_t res_0 = a00 - a0m1;
-            data_t res_1 = a00 - a01;
-            data_t res_2 = a00 - am10;
-            data_t res_3 = a00 - a10;
-
-            data_t b_val = (res_0 * res_0) + (res_1 * res_1) +
-                           (res_2 * res_2) + (res_3 * res_3);
-
-            // Προσθήκη του αποτελέσματος στη λίστα
-            B_golden_vec.push_back(b_val);
-        }
-    }
+    // Το ίδιο golden 5 σημείων με το cong_testbench.cpp (stencil_golden.h)
+    golden_stencil(A_vec, B_golden_vec, rows, columns);
     printf("  [Golden] Golden computation finished. Produced %zu outputs.\n", B_golden_vec.size());
 }
 
-int main() {
-    printf("[TB] Starting Testbench...\n");
+// Εκτελεί ένα μέγεθος πλαισίου και επιστρέφει τον αριθμό των λαθών
+int run_test(int rows, int columns) {
+    int total_elements = rows * columns;
+    int kernel_iterations = (rows - 2) * (columns - 2);
+
+    printf("[TB] Frame %d x %d\n", rows, columns);
 
     // 1. Δημιουργία Δεδομένων
     // Χρησιμοποιούμε vector της C++ Standard Library (STL)
-    std::vector<data_t> A_input_vector(TOTAL_ELEMENTS);
+    std::vector<data_t> A_input_vector(total_elements);
     std::vector<data_t> B_golden_vector;
     
     // Γέμισμα του vector εισόδου με απλά δεδομένα (π.χ., 0, 1, 2, ...)
-    for (int i = 0; i < TOTAL_ELEMENTS; i++) {
+    for (int i = 0; i < total_elements; i++) {
         A_input_vector[i] = (data_t)(i % 256); // Μια απλή "ράμπα"
     }
 
     // 2. Υπολογισμός "Golden" Αποτελέσματος
-    compute_golden(A_input_vector, B_golden_vector);
+    compute_golden(A_input_vector, B_golden_vector, rows, columns);
 
     // 3. Δημιουργία hls::stream και γέμισμα
     hls::stream<data_t> A_in_stream("A_in_stream");
     hls::stream<data_t> B_out_stream("B_out_stream");
 
     // Στέλνουμε όλα τα δεδομένα εισόδου στο HLS kernel
-    printf("[TB] Writing %d elements to HLS input stream...\n", TOTAL_ELEMENTS);
-    for (int i = 0; i < TOTAL_ELEMENTS; i++) {
+    printf("[TB] Writing %d elements to HLS input stream...\n", total_elements);
+    for (int i = 0; i < total_elements; i++) {
         A_in_stream.write(A_input_vector[i]);
     }
 
     // 4. Εκτέλεση του HLS Kernel (DUT)
     // Καλούμε το top-level function σας
     printf("[TB] Calling 'architecture_top_level' (HLS Kernel)...\n");
-    architecture_top_level(A_in_stream, B_out_stream);
+    architecture_top_level(A_in_stream, B_out_stream, rows, columns);
     printf("[TB] HLS Kernel execution finished.\n");
 
     // 5. Επαλήθευση Αποτελεσμάτων
     printf("[TB] Verifying results...\n");
     int errors = 0;
-    for (int i = 0; i < KERNEL_ITERATIONS; i++) {
+    for (int i = 0; i < kernel_iterations; i++) {
         // Διαβάζουμε το αποτέλεσμα από το HLS
         data_t hls_result = B_out_stream.read();
         
@@ -97,11 +82,21 @@ int main() {
                    i, hls_result, golden_result);
         }
     }
+    return errors;
+}
+
+int main() {
+    printf("[TB] Starting Testbench...\n");
+
+    int errors = 0;
+    for (int t = 0; t < NUM_TEST_SIZES; t++) {
+        errors += run_test(TEST_SIZES[t][0], TEST_SIZES[t][1]);
+    }
 
     // 6. Τελική Αναφορά
     if (errors == 0) {
         printf("\n--- TEST PASSED ---\n");
-        printf("All %d output values matched the golden reference.\n", KERNEL_ITERATIONS);
+        printf("All %d frame sizes matched the golden reference.\n", NUM_TEST_SIZES);
     } else {
         printf("\n--- TEST FAILED ---\n");
         printf("%d mismatches found.\n", errors);
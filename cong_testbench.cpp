@@ -1,98 +1,1248 @@
 #include <stdio.h>
 #include <vector>
+#include <algorithm>
 #include "ap_int.h"
 #include "ap_fixed.h"
 #include "hls_stream.h"
 #include "hls_math.h"
+#include "ap_axi_sdata.h"
+#include "stencil_driver.h"
+#if ENABLE_ROW_PROGRESS
+#include "hls_burst_maxi.h"
+#include "stencil_progress.h"
+#endif
+#if ENABLE_ROW_PROGRESS && defined(CSIM_THREADED)
+#include <thread>
+#endif
 
-typedef float data_t;
-const int ROWS = 16; 
-const int COLUMNS = 1024;
-const int TOTAL_ELEMENTS = ROWS * COLUMNS;
-const int KERNEL_ROWS = ROWS - 2;
-const int KERNEL_COLUMNS = COLUMNS - 2;
-const int KERNEL_ITERATIONS = KERNEL_ROWS * KERNEL_COLUMNS;
+#ifndef ENABLE_PERF_COUNTERS
+#define ENABLE_PERF_COUNTERS 0
+#endif
+
+#ifndef ENABLE_STATS
+#define ENABLE_STATS 0
+#endif
+
+// Input pixels are (i % 256 + INPUT_FRACTION) * INPUT_SCALE; the reduced formats
+// get inputs in [0, 1) (fixed point [0, 0.25)) so that B stays inside their
+// range, and INPUT_FRACTION keeps them off the grid of every reduced format, so
+// rounding A to DATA_FORMAT shows up in the reported error.
+// TOLERANCE (stencil_driver.h) is checked against the golden model of the
+// rounded A (see run_test).
+const float INPUT_FRACTION = 1.0f / 3;
+#if DATA_FORMAT == DATA_FORMAT_FLOAT
+const float INPUT_SCALE = 1.0f;
+#elif DATA_FORMAT == DATA_FORMAT_FIXED
+const float INPUT_SCALE = 1.0f / 1024;
+#else
+const float INPUT_SCALE = 1.0f / 256;
+#endif
+
+const int MAX_ROWS = 16; 
+
+// Frame sizes swept by the testbench (rows, columns); all run on the same kernel
+const int NUM_TEST_SIZES = 6;
+const int TEST_SIZES[NUM_TEST_SIZES][2] = {
+    {MAX_ROWS, MAX_COLUMNS}, {3, 3}, {5, 7}, {16, 513}, {9, 1000}, {12, 64}
+};
+
+// Boundary modes of architecture_top_level (see BOUNDARY MODES in the kernel)
+#define BOUNDARY_CROP 0
+#define BOUNDARY_ZERO 1
+#define BOUNDARY_CLAMP 2
+#define BOUNDARY_MIRROR 3
+#define BOUNDARY_PERIODIC 4
+
+// Frame sizes swept for every boundary mode but crop, each dense and pitched
+const int NUM_BOUNDARY_TEST_SIZES = 4;
+const int BOUNDARY_TEST_SIZES[NUM_BOUNDARY_TEST_SIZES][2] = {
+    {3, 3}, {5, 7}, {16, 513}, {12, 64}
+};
+
+#ifdef CSIM_THREADED
+const int LARGE_FRAME_ROWS = 1024;
+#endif
 
 // Prototype of the top-level function
-void architecture_top_level(data_t* A_in_mem, data_t* B_out_mem);
+#if ENABLE_PERF_COUNTERS
+// Counter layout of the kernel's PERFORMANCE COUNTERS section
+typedef ap_uint<32> perf_count_t;
+const int PERF_TOTAL_CYCLES = 0;
+const int PERF_LOAD_BUSY = 1;
+const int PERF_LOAD_BACKPRESSURE = 2;
+const int PERF_GMEM0_STALL = 3;
+const int PERF_STORE_BUSY = 4;
+const int PERF_STORE_STARVED = 5;
+const int PERF_GMEM1_STALL = 6;
+const int PERF_STEP_COUNTERS_BASE = 7;
+const int PERF_COMPUTE = 2 * NUM_POINTS;
+const int PERF_STEP_PROCESSES = 2 * NUM_POINTS + 2;
+const int NUM_PERF_COUNTERS = PERF_STEP_COUNTERS_BASE + 2 * TIME_STEPS * PERF_STEP_PROCESSES;
+
+int perf_step_counter(int step, int process) {
+    return PERF_STEP_COUNTERS_BASE + 2 * (step * PERF_STEP_PROCESSES + process);
+}
+#endif
 
-void compute_golden(std::vector<data_t>& A_vec, std::vector<data_t>& B_golden_vec) {
+#if ENABLE_STATS
+// Result layout of the kernel's OUTPUT STATISTICS section
+typedef ap_uint<32> stats_count_t;
+const int STATS_SUM = 0;
+const int STATS_MIN = 1;
+const int STATS_MAX = 2;
+const int NUM_STATS_VALUES = 3;
+const int STATS_BINS = 64;
+const int STATS_ABOVE_THRESHOLD = 0;
+const int STATS_BELOW_RANGE = 1;
+const int STATS_ABOVE_RANGE = 2;
+const int STATS_HISTOGRAM = 3;
+const int NUM_STATS_COUNTS = STATS_HISTOGRAM + STATS_BINS;
+#endif
+
+// With ENABLE_ROW_PROGRESS B is a manual-burst port (see ROW PROGRESS in the kernel)
+#if ENABLE_ROW_PROGRESS
+typedef hls::burst_maxi<mem_word_t> b_port_t;
+#else
+typedef mem_word_t* b_port_t;
+#endif
+
+void architecture_top_level(mem_word_t* A_in_mem, b_port_t B_out_mem,
+                            int rows, int columns, int boundary, int output_pitch
+#if ENABLE_STATS
+                            , int write_output, float threshold,
+                            float histogram_low, float histogram_high,
+                            float stats_values[NUM_STATS_VALUES],
+                            stats_count_t stats_counts[NUM_STATS_COUNTS]
+#endif
+#if ENABLE_PERF_COUNTERS
+                            , perf_count_t perf_counters[NUM_PERF_COUNTERS]
+#endif
+#if ENABLE_ROW_PROGRESS
+                            , volatile int* row_progress
+#endif
+                            );
+
+// Arguments and results of the optional architecture_top_level features
+struct top_level_options {
+#if ENABLE_STATS
+    int write_output = 1;
+    float threshold = 0.0f;
+    float histogram_low = 0.0f;
+    float histogram_high = 1.0f;
+    float stats_values[NUM_STATS_VALUES];
+    stats_count_t stats_counts[NUM_STATS_COUNTS];
+#endif
+#if ENABLE_PERF_COUNTERS
+    perf_count_t perf_counters[NUM_PERF_COUNTERS];
+#endif
+#if ENABLE_ROW_PROGRESS
+    volatile int row_progress = -1;
+#endif
+};
+
+void call_top_level(mem_word_t* A_in_mem, mem_word_t* B_out_mem,
+                    int rows, int columns, int boundary, int output_pitch,
+                    top_level_options& options) {
+    (void)options; // nothing to pass without the optional ports
+    architecture_top_level(A_in_mem, B_out_mem, rows, columns, boundary, output_pitch
+#if ENABLE_STATS
+                           , options.write_output, options.threshold,
+                           options.histogram_low, options.histogram_high,
+                           options.stats_values, options.stats_counts
+#endif
+#if ENABLE_PERF_COUNTERS
+                           , options.perf_counters
+#endif
+#if ENABLE_ROW_PROGRESS
+                           , &options.row_progress
+#endif
+                           );
+}
+
+#if ENABLE_ROW_PROGRESS
+// The row counter must end at output_rows once the kernel returns
+int check_row_progress(const top_level_options& options, int output_rows) {
+    if (options.row_progress != output_rows) {
+        printf("  [ERROR] row_progress = %d, expected %d\n", options.row_progress, output_rows);
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+#if STENCIL_SHAPE != 6
+// Gradient top level; fields selected with -DGRADIENT_OUTPUTS as in the kernel
+#define GRADIENT_SUM_SQ 1
+#define GRADIENT_DX 2
+#define GRADIENT_DY 4
+#define GRADIENT_MAGNITUDE 8
+#define GRADIENT_DIRECTION 16
+
+#ifndef GRADIENT_OUTPUTS
+#define GRADIENT_OUTPUTS (GRADIENT_SUM_SQ | GRADIENT_DX | GRADIENT_DY | GRADIENT_MAGNITUDE | GRADIENT_DIRECTION)
+#endif
+
+void architecture_top_level_gradient(mem_word_t* A_in_mem,
+                                     mem_word_t* B_sum_sq_mem, mem_word_t* B_dx_mem,
+                                     mem_word_t* B_dy_mem, mem_word_t* B_magnitude_mem,
+                                     mem_word_t* B_direction_mem,
+                                     int rows, int columns);
+#endif
+
+// Free-running AXI4-Stream top level (TUSER = start of frame, TLAST = end of frame)
+typedef ap_axiu<DATA_WIDTH * PARALLEL_FACTOR, 1, 1, 1> axis_word_t;
+
+void architecture_top_level_axis(hls::stream<axis_word_t>& A_in, hls::stream<axis_word_t>& B_out,
+                                 int rows, int columns);
+
+// Region-of-interest top level: B of every rectangle {row, column, height, width,
+// status} of roi_mem, packed one after the other; status and rois_done are outputs
+const int ROI_FIELDS = 5;
+const int ROI_STATUS = 4;
+const int ROI_DONE = 1;
+const int ROI_EMPTY = 2;
+const int ROI_OUTSIDE = 3;
+
+void architecture_top_level_roi(mem_word_t* A_in_mem, mem_word_t* B_out_mem, int* roi_mem,
+                                int rows, int columns, int num_rois, int* rois_done);
+
+// Resident iterative solver: up to max_iterations steps on the on-chip grid
+void architecture_top_level_resident(mem_word_t* A_in_mem, mem_word_t* B_out_mem,
+                                     int rows, int columns, int boundary,
+                                     int max_iterations, float tolerance,
+                                     int* iterations, float* last_change);
+
+#if PARALLEL_FACTOR == 1
+// Column-strip top level (PARALLEL_FACTOR 1 only)
+const int STRIP_UNITS = 4;
+
+void architecture_top_level_strips(mem_word_t* A_in_mem_0, mem_word_t* A_in_mem_1,
+                                   mem_word_t* A_in_mem_2, mem_word_t* A_in_mem_3,
+                                   mem_word_t* B_out_mem_0, mem_word_t* B_out_mem_1,
+                                   mem_word_t* B_out_mem_2, mem_word_t* B_out_mem_3,
+                                   int rows, int columns, int strips);
+
+// Extra frame sizes for the strip top level, wider than one line buffer
+const int NUM_WIDE_TEST_SIZES = 2;
+const int WIDE_TEST_SIZES[NUM_WIDE_TEST_SIZES][2] = {
+    {8, 2500}, {MAX_ROWS, 4 * (MAX_COLUMNS - 8)}
+};
+#endif
+
+void compute_golden(std::vector<data_t>& A_vec, std::vector<data_t>& B_golden_vec,
+                    int rows, int columns) {
 
     printf("  [Golden] Starting golden computation...\n");
-    // Clear the output vector to be sure
-    B_golden_vec.clear();
+    golden_stencil(A_vec, B_golden_vec, rows, columns);
+    printf("  [Golden] Golden computation finished. Produced %zu outputs.\n", B_golden_vec.size());
+}
 
-    // Loops from Listing 1 [cite: 55-59]
-    for (int i = 1; i < ROWS - 1; i++) {
-        for (int j = 1; j < COLUMNS - 1; j++) {
-            
-            // Convert 2D index to 1D index
-            data_t a10  = A_vec[(i + 1) * COLUMNS + j]; // A[i+1][j]
-            data_t a01  = A_vec[i * COLUMNS + (j + 1)]; // A[i][j+1]
-            data_t a00  = A_vec[i * COLUMNS + j];       // A[i][j]
-            data_t a0m1 = A_vec[i * COLUMNS + (j - 1)]; // A[i][j-1]
-            data_t am10 = A_vec[(i - 1) * COLUMNS + j]; // A[i-1][j]
+// The input pattern before it is rounded to DATA_FORMAT.
+// 'seed' shifts the pattern so that consecutive frames differ.
+void init_input_unrounded(std::vector<data_t>& RAM_in, int seed = 0) {
+    for (size_t i = 0; i < RAM_in.size(); i++) {
+        RAM_in[i] = ((data_t)((i + seed) % 256) + INPUT_FRACTION) * INPUT_SCALE;
+    }
+}
 
-            // Same operations as the kernel
-            data_t res_0 = a00 - a0m1;
-            data_t res_1 = a00 - a01;
-            data_t res_2 = a00 - am10;
-            data_t res_3 = a00 - a10;
+// Fill input vector with simple data, already rounded to DATA_FORMAT so the
+// golden model sees the same pixels as the kernel.
+void init_input(std::vector<data_t>& RAM_in, int seed = 0) {
+    printf("[TB] Initializing input memory...\n");
+    init_input_unrounded(RAM_in, seed);
+    for (size_t i = 0; i < RAM_in.size(); i++) {
+        RAM_in[i] = round_to_format(RAM_in[i]);
+    }
+}
+
+// Golden result of TIME_STEPS steps, each on the previous step's output
+void compute_golden_steps(const std::vector<data_t>& RAM_in, std::vector<data_t>& Golden_out,
+                          int rows, int columns) {
+    golden_stencil_steps(RAM_in, Golden_out, rows, columns, TIME_STEPS);
+}
 
-            data_t b_val = (res_0 * res_0) + (res_1 * res_1) +
-                           (res_2 * res_2) + (res_3 * res_3);
+// Same mapping as the kernel's boundary_index: source of pixel i, -1 for zero
+int golden_boundary_index(int i, int n, int boundary) {
+    if (i >= 0 && i < n) return i;
+    switch (boundary) {
+    case BOUNDARY_CLAMP:    return (i < 0) ? 0 : n - 1;
+    case BOUNDARY_MIRROR:   return (i < 0) ? -i : 2 * (n - 1) - i;
+    case BOUNDARY_PERIODIC: return (i < 0) ? i + n : i - n;
+    default:                return -1;
+    }
+}
 
-            // Add result to the list
-            B_golden_vec.push_back(b_val);
+// A extended by 'steps' halos on every side, as load_input streams it
+void pad_input(const std::vector<data_t>& RAM_in, std::vector<data_t>& Padded,
+               int rows, int columns, int boundary, int steps = TIME_STEPS) {
+    halo_t h = stencil_halo();
+    int padded_rows = rows + steps * (h.top + h.bottom);
+    int padded_columns = columns + steps * (h.left + h.right);
+    Padded.assign(padded_rows * padded_columns, 0);
+    for (int i = 0; i < padded_rows; i++) {
+        int r = golden_boundary_index(i - steps * h.top, rows, boundary);
+        for (int j = 0; j < padded_columns; j++) {
+            int c = golden_boundary_index(j - steps * h.left, columns, boundary);
+            if (r >= 0 && c >= 0) {
+                Padded[i * padded_columns + j] = RAM_in[r * columns + c];
+            }
         }
     }
-    printf("  [Golden] Golden computation finished. Produced %zu outputs.\n", B_golden_vec.size());
 }
 
-int main() {
-    printf("[TB] Starting Testbench...\n");
+// Golden B of architecture_top_level: on A padded for 'boundary' unless cropped
+void compute_golden_grid(const std::vector<data_t>& RAM_in, std::vector<data_t>& Golden_out,
+                         int rows, int columns, int boundary) {
+    if (boundary == BOUNDARY_CROP) {
+        compute_golden_steps(RAM_in, Golden_out, rows, columns);
+    } else {
+        halo_t h = stencil_halo();
+        std::vector<data_t> Padded_in;
+        pad_input(RAM_in, Padded_in, rows, columns, boundary);
+        compute_golden_steps(Padded_in, Golden_out, rows + TIME_STEPS * (h.top + h.bottom),
+                             columns + TIME_STEPS * (h.left + h.right));
+    }
+}
+
+// B rows written output_pitch pixels apart
+void unpack_pitched(const std::vector<mem_word_t>& words, std::vector<data_t>& values,
+                    int output_rows, int output_columns, int output_pitch) {
+    for (int r = 0; r < output_rows; r++) {
+        for (int c = 0; c < output_columns; c++) {
+            int i = r * output_pitch + c;
+            int l = i % P;
+            ap_uint<DATA_WIDTH> bits = words[i / P].range(DATA_WIDTH * l + DATA_WIDTH - 1, DATA_WIDTH * l);
+            values[r * output_columns + c] = active_format::to_float(active_format::from_bits(bits));
+        }
+    }
+}
+
+#if ENABLE_PERF_COUNTERS
+// The busy counts are exact word counts; rows/columns are the grid the network
+// works on (A padded in the boundary modes). Returns the number of wrong ones
+int check_perf_counters(const perf_count_t* counters, int rows, int columns,
+                        int halo_rows, int halo_columns) {
+    int errors = 0;
+    int in_words = (rows * columns + P - 1) / P;
+    int out_words = ((rows - TIME_STEPS * halo_rows) * (columns - TIME_STEPS * halo_columns) + P - 1) / P;
+    if (counters[PERF_LOAD_BUSY].to_int() != in_words) errors++;
+    if (counters[PERF_STORE_BUSY].to_int() != out_words) errors++;
+    for (int t = 0; t < TIME_STEPS; t++) {
+        int step_in = ((rows - t * halo_rows) * (columns - t * halo_columns) + P - 1) / P;
+        int step_out = ((rows - (t + 1) * halo_rows) * (columns - (t + 1) * halo_columns) + P - 1) / P;
+        if (counters[perf_step_counter(t, 0)].to_int() != step_in) errors++;
+        if (counters[perf_step_counter(t, PERF_COMPUTE)].to_int() != step_out) errors++;
+    }
+
+    printf("[TB] Counters: %u cycles, load %u busy / %u backpressure / %u gmem0 stall, "
+           "store %u busy / %u starved / %u gmem1 stall\n",
+           counters[PERF_TOTAL_CYCLES].to_uint(), counters[PERF_LOAD_BUSY].to_uint(),
+           counters[PERF_LOAD_BACKPRESSURE].to_uint(), counters[PERF_GMEM0_STALL].to_uint(),
+           counters[PERF_STORE_BUSY].to_uint(), counters[PERF_STORE_STARVED].to_uint(),
+           counters[PERF_GMEM1_STALL].to_uint());
+    if (errors) {
+        printf("  [ERROR] %d busy counters do not match the frame size\n", errors);
+    }
+    return errors;
+}
+#endif
+
+// Runs one frame size through the kernel and returns the number of mismatches.
+// output_pitch 0 = dense B, else B rows output_pitch pixels apart.
+int run_test(int rows, int columns, int boundary = BOUNDARY_CROP, int output_pitch = 0) {
+    halo_t h = stencil_halo();
+    int halo_rows = h.top + h.bottom;
+    int halo_columns = h.left + h.right;
+    int pad_rows = TIME_STEPS * std::max(h.top, h.bottom);
+    int pad_columns = TIME_STEPS * std::max(h.left, h.right);
+    if (boundary == BOUNDARY_CROP &&
+        (rows <= TIME_STEPS * halo_rows || columns <= TIME_STEPS * halo_columns)) {
+        printf("[TB] Frame %d x %d skipped: smaller than %d stencil steps\n", rows, columns, TIME_STEPS);
+        return 0;
+    }
+    if (boundary != BOUNDARY_CROP && columns + TIME_STEPS * halo_columns > MAX_COLUMNS) {
+        printf("[TB] Frame %d x %d skipped: padded frame wider than MAX_COLUMNS\n", rows, columns);
+        return 0;
+    }
+    if ((boundary == BOUNDARY_MIRROR && (rows <= pad_rows || columns <= pad_columns)) ||
+        (boundary == BOUNDARY_PERIODIC && (rows < pad_rows || columns < pad_columns))) {
+        printf("[TB] Frame %d x %d skipped: smaller than the boundary pad\n", rows, columns);
+        return 0;
+    }
+
+    int total_elements = rows * columns;
+    int grid_rows = rows;
+    int grid_columns = columns;
+    if (boundary != BOUNDARY_CROP) {
+        grid_rows += TIME_STEPS * halo_rows;
+        grid_columns += TIME_STEPS * halo_columns;
+    }
+    int output_rows = grid_rows - TIME_STEPS * halo_rows;
+    int output_columns = grid_columns - TIME_STEPS * halo_columns;
+    int kernel_iterations = output_rows * output_columns;
+
+    int in_words = (total_elements + P - 1) / P;
+    int out_words = (kernel_iterations + P - 1) / P;
+    if (output_pitch != 0) {
+        out_words = (output_rows - 1) * output_pitch / P + (output_columns + P - 1) / P;
+    }
+
+    printf("[TB] Frame %d x %d, %d pixels per word, %d time steps, boundary %d, pitch %d\n",
+           rows, columns, P, TIME_STEPS, boundary, output_pitch);
 
     // 1. Create Data
-    std::vector<data_t> RAM_in(TOTAL_ELEMENTS);
-    std::vector<data_t> RAM_out(KERNEL_ITERATIONS); // Output is smaller
+    std::vector<data_t> RAM_in(total_elements);
+    std::vector<data_t> RAM_out(kernel_iterations); // Output is smaller
     std::vector<data_t> Golden_out;
-    
-    // Fill input vector with simple data (e.g., 0, 1, 2, ...)
-    printf("[TB] Initializing input memory...\n");
-    for (int i = 0; i < TOTAL_ELEMENTS; i++) {
-        RAM_in[i] = (data_t)(i % 256);
-    }
+    init_input(RAM_in);
 
-    // 2. Compute "Golden" Result
-    compute_golden(RAM_in, Golden_out);
+    // 2. Compute "Golden" Result (on A padded for the boundary mode): on the
+    // rounded A for the tolerance check, and on the unrounded A for the error
+    // of the format as a whole, input quantisation included
+    compute_golden_grid(RAM_in, Golden_out, rows, columns, boundary);
+    std::vector<data_t> Unrounded_in(total_elements);
+    std::vector<data_t> Float_golden_out;
+    init_input_unrounded(Unrounded_in);
+    compute_golden_grid(Unrounded_in, Float_golden_out, rows, columns, boundary);
+
+    // 3. Pack into AXI words (buffers rounded up to whole words)
+    const mem_word_t UNTOUCHED = 0x5A5A5A5A;
+    std::vector<mem_word_t> AXI_in(in_words, 0);
+    std::vector<mem_word_t> AXI_out(out_words, UNTOUCHED);
+    pack_words(RAM_in, AXI_in);
 
     // 4. Run HLS Kernel
 
     printf("[TB] Calling 'architecture_top_level' with memory pointers...\n");
     
-    architecture_top_level(RAM_in.data(), RAM_out.data());
+    top_level_options options;
+    call_top_level(AXI_in.data(), AXI_out.data(), rows, columns, boundary, output_pitch, options);
     
     printf("[TB] Execution finished.\n");
+    if (output_pitch == 0) {
+        unpack_words(AXI_out, RAM_out);
+    } else {
+        unpack_pitched(AXI_out, RAM_out, output_rows, output_columns, output_pitch);
+    }
 
     // 5. Verify Results
     printf("[TB] Verifying results...\n");
     int errors = 0;
-    for (int i = 0; i < KERNEL_ITERATIONS; i++) {
+#if ENABLE_PERF_COUNTERS
+    errors += check_perf_counters(options.perf_counters, grid_rows, grid_columns, halo_rows, halo_columns);
+#endif
+#if ENABLE_ROW_PROGRESS
+    errors += check_row_progress(options, output_rows);
+#endif
+    // The words between pitched rows belong to the host: every row's write has
+    // to stop at its last word (with ENABLE_ROW_PROGRESS, its burst request)
+    if (output_pitch != 0) {
+        int row_words = (output_columns + P - 1) / P;
+        for (int r = 0; r + 1 < output_rows; r++) {
+            for (int w = r * output_pitch / P + row_words; w < (r + 1) * output_pitch / P; w++) {
+                if (AXI_out[w] != UNTOUCHED) {
+                    errors++;
+                    printf("  [ERROR] word %d after row %d of B written\n", w, r);
+                    r = output_rows;
+                    break;
+                }
+            }
+        }
+    }
+    double max_abs_error = 0.0;
+    double max_rel_error = 0.0;
+    for (int i = 0; i < kernel_iterations; i++) {
         data_t hls_val = RAM_out[i]; // Read from output memory
         data_t ref_val = Golden_out[i];
+        data_t float_val = Float_golden_out[i];
+
+        // Error of the format against the float model of the unrounded A
+        double float_error = std::abs((double)hls_val - (double)float_val);
+        max_abs_error = std::max(max_abs_error, float_error);
+        if (float_val != 0) {
+            max_rel_error = std::max(max_rel_error, float_error / std::abs((double)float_val));
+        }
 
-        // Float comparison
-        if (std::abs(hls_val - ref_val) > 0.001) {
+        // Float comparison (relative once later time steps make the values large)
+        double abs_error = std::abs((double)hls_val - (double)ref_val);
+        if (abs_error > TOLERANCE * std::max(1.0, std::abs((double)ref_val))) {
             errors++;
             if (errors < 10) {
                 printf("  [ERROR] i=%d HLS=%f Ref=%f\n", i, hls_val, ref_val);
             }
         }
     }
+    printf("[TB] DATA_FORMAT %d: max abs error %g, max rel error %g against the float golden model\n",
+           DATA_FORMAT, max_abs_error, max_rel_error);
+    return errors;
+}
+
+#if ENABLE_STATS
+// Checks the statistics against the B the kernel wrote, then runs again with
+// write_output off: same statistics, B_out_mem untouched. With nan_pixel one
+// pixel in the middle of A is NaN, so the NaN pixels of B have to land in
+// STATS_ABOVE_RANGE. With bin_period > 0, A repeats every bin_period * P
+// columns (and every 3 rows), so each lane of B hits the same bins with period
+// bin_period: bins that come back 1, 2 or 3 words later catch a histogram
+// update that reads its bin before the previous write of it has landed (cosim).
+int run_stats_test(int rows, int columns, int boundary, bool nan_pixel = false, int bin_period = 0) {
+    halo_t h = stencil_halo();
+    int halo_rows = TIME_STEPS * (h.top + h.bottom);
+    int halo_columns = TIME_STEPS * (h.left + h.right);
+    if (boundary == BOUNDARY_CROP && (rows <= halo_rows || columns <= halo_columns)) {
+        return 0;
+    }
+    int output_rows = (boundary == BOUNDARY_CROP) ? rows - halo_rows : rows;
+    int output_columns = (boundary == BOUNDARY_CROP) ? columns - halo_columns : columns;
+    int output_elements = output_rows * output_columns;
+    int out_words = (output_elements + P - 1) / P;
+
+    printf("[TB] Statistics of frame %d x %d, boundary %d%s", rows, columns, boundary,
+           nan_pixel ? ", one NaN pixel" : "");
+    if (bin_period > 0) printf(", bin period %d", bin_period);
+    printf("\n");
+
+    std::vector<data_t> RAM_in(rows * columns);
+    init_input(RAM_in);
+    for (int i = 0; i < rows && bin_period > 0; i++) {
+        for (int j = 0; j < columns; j++) {
+            int phase = (i % 3) * bin_period * P + j % (bin_period * P);
+            data_t value = ((data_t)((phase * phase * 29 + 13) % 97) + INPUT_FRACTION) * INPUT_SCALE;
+            RAM_in[i * columns + j] = round_to_format(value);
+        }
+    }
+    if (nan_pixel) {
+        RAM_in[(rows / 2) * columns + columns / 2] = std::nanf("");
+    }
+    std::vector<mem_word_t> AXI_in((rows * columns + P - 1) / P, 0);
+    pack_words(RAM_in, AXI_in);
+
+    // First run only to place the threshold and the histogram range inside B
+    std::vector<mem_word_t> AXI_out(out_words, 0);
+    std::vector<data_t> RAM_out(output_elements);
+    top_level_options options;
+    call_top_level(AXI_in.data(), AXI_out.data(), rows, columns, boundary, 0, options);
+    unpack_words(AXI_out, RAM_out);
+    float largest = *std::max_element(RAM_out.begin(), RAM_out.end());
+    options.threshold = 0.5f * largest;
+    options.histogram_low = 0.1f * largest;
+    options.histogram_high = 0.75f * largest;
+    if (bin_period > 0) {
+        // Every pixel of B in a bin
+        options.histogram_low = 0.5f * *std::min_element(RAM_out.begin(), RAM_out.end());
+        options.histogram_high = largest + (largest - options.histogram_low) / STATS_BINS;
+    }
+    call_top_level(AXI_in.data(), AXI_out.data(), rows, columns, boundary, 0, options);
+
+    // Reference statistics of the pixels actually written (same float arithmetic)
+    double sum = 0.0;
+    float minimum = RAM_out[0];
+    float maximum = RAM_out[0];
+    std::vector<int> counts(NUM_STATS_COUNTS, 0);
+    std::vector<int> bins(output_elements, -1);
+    float bin_scale = STATS_BINS / (options.histogram_high - options.histogram_low);
+    for (int i = 0; i < output_elements; i++) {
+        float value = RAM_out[i];
+        sum += value;
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+        if (value > options.threshold) counts[STATS_ABOVE_THRESHOLD]++;
+        if (value < options.histogram_low) {
+            counts[STATS_BELOW_RANGE]++;
+        } else if (!(value < options.histogram_high)) {
+            counts[STATS_ABOVE_RANGE]++;
+        } else {
+            int bin = (int)((value - options.histogram_low) * bin_scale);
+            bins[i] = std::min(bin, STATS_BINS - 1);
+            counts[STATS_HISTOGRAM + bins[i]]++;
+        }
+    }
+
+    int errors = 0;
+    if (bin_period > 0) {
+        // The pattern is only a test if lanes come back to a bin exactly
+        // bin_period words later, with another bin in between
+        int repeats = 0;
+        for (int i = bin_period * P; i < output_elements; i++) {
+            if (bins[i] >= 0 && bins[i] == bins[i - bin_period * P] &&
+                (bin_period == 1 || bins[i] != bins[i - P])) {
+                repeats++;
+            }
+        }
+        printf("[TB] %d pixels hit the bin of %d words before\n", repeats, bin_period);
+        if (repeats == 0) {
+            errors++;
+            printf("  [ERROR] B does not repeat its bins with period %d\n", bin_period);
+        }
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        if (std::abs(options.stats_values[STATS_SUM] - sum) > 1e-4 * std::max(1.0, std::abs(sum)) ||
+            options.stats_values[STATS_MIN] != minimum || options.stats_values[STATS_MAX] != maximum) {
+            errors++;
+            printf("  [ERROR] sum/min/max %f %f %f, expected %f %f %f\n",
+                   options.stats_values[STATS_SUM], options.stats_values[STATS_MIN],
+                   options.stats_values[STATS_MAX], sum, minimum, maximum);
+        }
+        for (int k = 0; k < NUM_STATS_COUNTS; k++) {
+            if (options.stats_counts[k].to_int() != counts[k]) {
+                errors++;
+                if (errors < 10) {
+                    printf("  [ERROR] count %d = %d, expected %d\n", k, options.stats_counts[k].to_int(), counts[k]);
+                }
+            }
+        }
+        if (pass == 1) break;
+
+        // Statistics only: B must not be written
+        std::vector<mem_word_t> Untouched(out_words, 0x5A5A5A5A);
+        options.write_output = 0;
+        call_top_level(AXI_in.data(), Untouched.data(), rows, columns, boundary, 0, options);
+#if ENABLE_ROW_PROGRESS
+        errors += check_row_progress(options, output_rows);
+#endif
+        for (int i = 0; i < out_words; i++) {
+            if (Untouched[i] != mem_word_t(0x5A5A5A5A)) {
+                errors++;
+                printf("  [ERROR] B word %d written with write_output = 0\n", i);
+                break;
+            }
+        }
+    }
+    printf("[TB] Sum %g, min %g, max %g, %d above threshold\n",
+           options.stats_values[STATS_SUM], options.stats_values[STATS_MIN],
+           options.stats_values[STATS_MAX], options.stats_counts[STATS_ABOVE_THRESHOLD].to_int());
+    return errors;
+}
+#endif
+
+#if ENABLE_ROW_PROGRESS && defined(CSIM_THREADED)
+// Consumer of the row counter: the kernel runs on its own thread while this one
+// waits for every band of ROW_PROGRESS_BAND rows with stencil_progress.h and
+// checks it against the golden B as soon as it is published.
+const int ROW_PROGRESS_BAND = 8;
+
+int run_row_progress_test(int rows, int columns, int output_pitch) {
+    halo_t h = stencil_halo();
+    int output_rows = rows - TIME_STEPS * (h.top + h.bottom);
+    int output_columns = columns - TIME_STEPS * (h.left + h.right);
+    int out_words = (output_rows * output_columns + P - 1) / P;
+    if (output_pitch != 0) {
+        out_words = (output_rows - 1) * output_pitch / P + (output_columns + P - 1) / P;
+    }
+
+    printf("[TB] Row progress of frame %d x %d, pitch %d, bands of %d rows\n",
+           rows, columns, output_pitch, ROW_PROGRESS_BAND);
+
+    std::vector<data_t> RAM_in(rows * columns);
+    std::vector<data_t> Golden_out;
+    init_input(RAM_in);
+    compute_golden_steps(RAM_in, Golden_out, rows, columns);
+    std::vector<mem_word_t> AXI_in((rows * columns + P - 1) / P, 0);
+    std::vector<mem_word_t> AXI_out(out_words, 0);
+    pack_words(RAM_in, AXI_in);
+
+    top_level_options options;
+    stencil_progress_reset(&options.row_progress);
+    std::thread kernel([&]() {
+        call_top_level(AXI_in.data(), AXI_out.data(), rows, columns, BOUNDARY_CROP, output_pitch, options);
+    });
+
+    int errors = 0;
+    int early_bands = 0;
+    int row_stride = (output_pitch == 0) ? output_columns : output_pitch;
+    for (int begin = 0; begin < output_rows; begin += ROW_PROGRESS_BAND) {
+        int end = std::min(begin + ROW_PROGRESS_BAND, output_rows);
+        if (!stencil_wait_rows(&options.row_progress, end, 10000)) {
+            printf("  [ERROR] rows [%d, %d) not published, row_progress = %d\n",
+                   begin, end, stencil_rows_done(&options.row_progress));
+            errors++;
+            break;
+        }
+        if (stencil_rows_done(&options.row_progress) < output_rows) early_bands++;
+
+        stencil_row_words span = stencil_rows_span(begin, end, output_columns, output_pitch, P);
+        if (span.first + span.count > (size_t)out_words ||
+            span.first > (size_t)(begin * row_stride / P) ||
+            span.first + span.count < (size_t)(((end - 1) * row_stride + output_columns + P - 1) / P)) {
+            printf("  [ERROR] rows [%d, %d) span words [%zu, +%zu)\n", begin, end, span.first, span.count);
+            errors++;
+        }
+        for (int r = begin; r < end; r++) {
+            for (int c = 0; c < output_columns; c++) {
+                int i = r * row_stride + c;
+                int l = i % P;
+                ap_uint<DATA_WIDTH> bits = AXI_out[i / P].range(DATA_WIDTH * l + DATA_WIDTH - 1, DATA_WIDTH * l);
+                double hls_val = active_format::to_float(active_format::from_bits(bits));
+                double ref_val = Golden_out[r * output_columns + c];
+                if (std::abs(hls_val - ref_val) > TOLERANCE * std::max(1.0, std::abs(ref_val))) {
+                    errors++;
+                    if (errors < 10) {
+                        printf("  [ERROR] row %d column %d HLS=%f Ref=%f\n", r, c, hls_val, ref_val);
+                    }
+                }
+            }
+        }
+    }
+    kernel.join();
+    errors += check_row_progress(options, output_rows);
+    printf("[TB] %d of %d bands taken before the last row was written\n",
+           early_bands, (output_rows + ROW_PROGRESS_BAND - 1) / ROW_PROGRESS_BAND);
+    return errors;
+}
+#endif
+
+#if STENCIL_SHAPE != 6
+// Same sectors as the kernel's gradient_direction
+int golden_direction(float dx, float dy) {
+    float ax = std::abs(dx);
+    float ay = std::abs(dy);
+    if (ay <= ax * 0.41421356f) return (dx >= 0) ? 0 : 4;
+    if (ay >= ax * 2.41421356f) return (dy >= 0) ? 2 : 6;
+    if (dx >= 0) return (dy >= 0) ? 1 : 7;
+    return (dy >= 0) ? 3 : 5;
+}
+
+// Compares the selected gradient fields with the golden model (one time step).
+// The direction is checked against the kernel's own dx/dy, so that a rounded
+// dx or dy on a sector edge does not count as an error.
+int run_gradient_test(int rows, int columns) {
+    halo_t h = stencil_halo();
+    int output_rows = rows - (h.top + h.bottom);
+    int output_columns = columns - (h.left + h.right);
+    if (output_rows <= 0 || output_columns <= 0) {
+        return 0;
+    }
+    int output_elements = output_rows * output_columns;
+    int out_words = (output_elements + P - 1) / P;
+
+    printf("[TB] Gradient of frame %d x %d, fields 0x%x\n", rows, columns, GRADIENT_OUTPUTS);
+
+    std::vector<data_t> RAM_in(rows * columns);
+    init_input(RAM_in);
+    std::vector<mem_word_t> AXI_in((rows * columns + P - 1) / P, 0);
+    pack_words(RAM_in, AXI_in);
+
+    const int NUM_FIELDS = 5;
+    std::vector<mem_word_t> AXI_field[NUM_FIELDS];
+    std::vector<data_t> Field[NUM_FIELDS];
+    for (int f = 0; f < NUM_FIELDS; f++) {
+        AXI_field[f].assign(out_words, 0);
+        Field[f].resize(output_elements);
+    }
+    architecture_top_level_gradient(AXI_in.data(), AXI_field[0].data(), AXI_field[1].data(),
+                                    AXI_field[2].data(), AXI_field[3].data(), AXI_field[4].data(),
+                                    rows, columns);
+    for (int f = 0; f < NUM_FIELDS; f++) {
+        unpack_words(AXI_field[f], Field[f]);
+    }
+
+    std::vector<data_t> Golden_sum_sq;
+    compute_golden(RAM_in, Golden_sum_sq, rows, columns);
+
+    int errors = 0;
+    for (int i = 0; i < output_rows; i++) {
+        for (int j = 0; j < output_columns; j++) {
+            int n = i * output_columns + j;
+            int a = (i + h.top) * columns + (j + h.left);
+            double dx = 0.5 * ((double)RAM_in[a + 1] - (double)RAM_in[a - 1]);
+            double dy = 0.5 * ((double)RAM_in[a + columns] - (double)RAM_in[a - columns]);
+            double golden[NUM_FIELDS] = {
+                Golden_sum_sq[n], dx, dy, std::sqrt(dx * dx + dy * dy),
+                (double)golden_direction(Field[1][n], Field[2][n])
+            };
+            for (int f = 0; f < NUM_FIELDS; f++) {
+                if (!(GRADIENT_OUTPUTS & (1 << f))) continue;
+                if (f == 4 && !((GRADIENT_OUTPUTS & GRADIENT_DX) && (GRADIENT_OUTPUTS & GRADIENT_DY))) continue;
+                double error = std::abs((double)Field[f][n] - golden[f]);
+                if (error > TOLERANCE * std::max(1.0, std::abs(golden[f]))) {
+                    errors++;
+                    if (errors < 10) {
+                        printf("  [ERROR] field %d i=%d HLS=%f Ref=%f\n", f, n, Field[f][n], golden[f]);
+                    }
+                }
+            }
+        }
+    }
+
+    // Unselected fields must stay untouched
+    for (int f = 0; f < NUM_FIELDS; f++) {
+        if (GRADIENT_OUTPUTS & (1 << f)) continue;
+        for (int w = 0; w < out_words; w++) {
+            if (AXI_field[f][w] != mem_word_t(0)) {
+                errors++;
+                printf("  [ERROR] unselected field %d written\n", f);
+                break;
+            }
+        }
+    }
+    return errors;
+}
+#endif
+
+// One iteration of the resident solver on a rows x columns grid: the interior
+// with the border kept (crop) or the grid padded by one halo (other modes), with
+// the result rounded to DATA_FORMAT. Returns the largest pixel change.
+float golden_resident_iteration(const std::vector<data_t>& In, std::vector<data_t>& Out,
+                                int rows, int columns, int boundary) {
+    halo_t h = stencil_halo();
+    std::vector<data_t> B;
+    if (boundary == BOUNDARY_CROP) {
+        golden_stencil(In, B, rows, columns);
+        Out = In;
+        int output_columns = columns - (h.left + h.right);
+        for (size_t n = 0; n < B.size(); n++) {
+            int i = h.top + n / output_columns;
+            int j = h.left + n % output_columns;
+            Out[i * columns + j] = B[n];
+        }
+    } else {
+        std::vector<data_t> Padded;
+        pad_input(In, Padded, rows, columns, boundary, 1);
+        golden_stencil(Padded, Out, rows + h.top + h.bottom, columns + h.left + h.right);
+    }
+
+    float max_change = 0.0f;
+    for (size_t n = 0; n < Out.size(); n++) {
+        Out[n] = round_to_format(Out[n]);
+        max_change = std::max(max_change, std::abs(Out[n] - In[n]));
+    }
+    return max_change;
+}
+
+// Runs the resident solver and checks B, the number of iterations and the last
+// change against golden_resident_iteration. The inputs are below
+// 1/(4*(NUM_POINTS-1)), where every iteration shrinks the grid towards its
+// fixed point, so the values stay inside every format's range.
+int run_resident_test(int rows, int columns, int boundary, int max_iterations, float tolerance) {
+    halo_t h = stencil_halo();
+    int halo_rows = h.top + h.bottom;
+    int halo_columns = h.left + h.right;
+    if ((boundary == BOUNDARY_CROP && (rows <= halo_rows || columns <= halo_columns)) ||
+        (boundary != BOUNDARY_CROP && columns + halo_columns > MAX_COLUMNS) ||
+        (boundary == BOUNDARY_MIRROR && (rows <= std::max(h.top, h.bottom) ||
+                                         columns <= std::max(h.left, h.right))) ||
+        (boundary == BOUNDARY_PERIODIC && (rows < std::max(h.top, h.bottom) ||
+                                           columns < std::max(h.left, h.right)))) {
+        return 0;
+    }
+
+    int total_elements = rows * columns;
+    int words = (total_elements + P - 1) / P;
+    printf("[TB] Resident solver on frame %d x %d, boundary %d, up to %d iterations, tolerance %g\n",
+           rows, columns, boundary, max_iterations, tolerance);
+
+    std::vector<data_t> RAM_in(total_elements);
+    float scale = 1.0f / (4 * (NUM_POINTS - 1) * 256);
+    for (int i = 0; i < total_elements; i++) {
+        RAM_in[i] = round_to_format((data_t)(i % 256) * scale);
+    }
+
+    std::vector<data_t> Golden = RAM_in;
+    std::vector<data_t> Next;
+    int golden_iterations = 0;
+    float golden_change = 0.0f;
+    while (golden_iterations < max_iterations) {
+        golden_change = golden_resident_iteration(Golden, Next, rows, columns, boundary);
+        Golden.swap(Next);
+        golden_iterations++;
+        if (golden_change < tolerance) break;
+    }
+
+    std::vector<mem_word_t> AXI_in(words, 0);
+    std::vector<mem_word_t> AXI_out(words, 0);
+    pack_words(RAM_in, AXI_in);
+    int iterations = -1;
+    float last_change = -1.0f;
+    architecture_top_level_resident(AXI_in.data(), AXI_out.data(), rows, columns, boundary,
+                                    max_iterations, tolerance, &iterations, &last_change);
+    std::vector<data_t> RAM_out(total_elements);
+    unpack_words(AXI_out, RAM_out);
+
+    int errors = 0;
+    if (iterations != golden_iterations ||
+        std::abs(last_change - golden_change) > TOLERANCE * std::max(1.0f, golden_change)) {
+        errors++;
+        printf("  [ERROR] %d iterations, last change %g; expected %d, %g\n",
+               iterations, last_change, golden_iterations, golden_change);
+    }
+    error_stats stats = compare_outputs(RAM_out, Golden, TOLERANCE);
+    if (stats.mismatches) {
+        errors += stats.mismatches;
+        printf("  [ERROR] %ld mismatches, max abs error %g\n", stats.mismatches, stats.max_abs_error);
+    }
+    printf("[TB] %d iterations, last change %g\n", iterations, last_change);
+    return errors;
+}
+
+// Runs a list of rectangles through the ROI top level and checks each one against
+// the same pixels of the full-frame golden B. The list mixes word-aligned and
+// unaligned rectangles, single pixels, the whole interior, an empty rectangle and
+// rectangles that reach outside the valid region, whose words must stay
+// untouched; every status word and rois_done are checked as well.
+int run_roi_test(int rows, int columns) {
+    halo_t h = stencil_halo();
+    int pad_top = TIME_STEPS * h.top;
+    int pad_left = TIME_STEPS * h.left;
+    int output_rows = rows - TIME_STEPS * (h.top + h.bottom);
+    int output_columns = columns - TIME_STEPS * (h.left + h.right);
+    if (output_rows <= 0 || output_columns <= 0) {
+        return 0;
+    }
+
+    // {row, column, height, width, status} in A coordinates
+    std::vector<int> rois = {
+        pad_top, pad_left, output_rows, output_columns, 0,
+        pad_top + output_rows / 2, pad_left + output_columns / 3, (output_rows + 1) / 2, (output_columns + 2) / 3, 0,
+        pad_top, pad_left + output_columns - 1, 1, 1, 0,
+        pad_top + output_rows - 1, pad_left, 1, output_columns, 0,
+        pad_top, pad_left, 0, output_columns, 0,
+        0, 0, rows, columns, 0,
+        pad_top, pad_left + 1, output_rows, output_columns, 0
+    };
+    const int NUM_OUTSIDE = 2; // the last two do not fit
+    const int EMPTY_ROI = 4;
+    int num_rois = rois.size() / ROI_FIELDS;
+
+    printf("[TB] %d regions of interest in frame %d x %d\n", num_rois, rows, columns);
+
+    std::vector<data_t> RAM_in(rows * columns);
+    init_input(RAM_in);
+    std::vector<mem_word_t> AXI_in((rows * columns + P - 1) / P, 0);
+    pack_words(RAM_in, AXI_in);
+    std::vector<data_t> Golden_out;
+    compute_golden_steps(RAM_in, Golden_out, rows, columns);
+
+    std::vector<int> offsets(num_rois + 1, 0);
+    for (int n = 0; n < num_rois; n++) {
+        int pixels = rois[n * ROI_FIELDS + 2] * rois[n * ROI_FIELDS + 3];
+        offsets[n + 1] = offsets[n] + (pixels + P - 1) / P;
+    }
+    const mem_word_t UNTOUCHED = 0x5A5A5A5A;
+    std::vector<mem_word_t> AXI_out(offsets[num_rois], UNTOUCHED);
+    int rois_done = -1;
+    architecture_top_level_roi(AXI_in.data(), AXI_out.data(), rois.data(), rows, columns, num_rois, &rois_done);
+
+    int errors = 0;
+    if (rois_done != num_rois - NUM_OUTSIDE - 1) {
+        errors++;
+        printf("  [ERROR] %d regions of interest reported done, expected %d\n",
+               rois_done, num_rois - NUM_OUTSIDE - 1);
+    }
+    for (int n = 0; n < num_rois; n++) {
+        int expected = (n >= num_rois - NUM_OUTSIDE) ? ROI_OUTSIDE : (n == EMPTY_ROI) ? ROI_EMPTY : ROI_DONE;
+        if (rois[n * ROI_FIELDS + ROI_STATUS] != expected) {
+            errors++;
+            printf("  [ERROR] ROI %d status %d, expected %d\n", n, rois[n * ROI_FIELDS + ROI_STATUS], expected);
+        }
+    }
+    for (int n = 0; n < num_rois; n++) {
+        int row = rois[n * ROI_FIELDS + 0];
+        int column = rois[n * ROI_FIELDS + 1];
+        int height = rois[n * ROI_FIELDS + 2];
+        int width = rois[n * ROI_FIELDS + 3];
+        int words = offsets[n + 1] - offsets[n];
+        std::vector<mem_word_t> Words(AXI_out.begin() + offsets[n], AXI_out.begin() + offsets[n + 1]);
+
+        if (n >= num_rois - NUM_OUTSIDE) {
+            for (int w = 0; w < words; w++) {
+                if (Words[w] != UNTOUCHED) {
+                    errors++;
+                    printf("  [ERROR] ROI %d outside the valid region was written\n", n);
+                    break;
+                }
+            }
+            continue;
+        }
+
+        std::vector<data_t> RAM_out(height * width);
+        unpack_words(Words, RAM_out);
+        for (int i = 0; i < height; i++) {
+            for (int j = 0; j < width; j++) {
+                data_t hls_val = RAM_out[i * width + j];
+                data_t ref_val = Golden_out[(row + i - pad_top) * output_columns + (column + j - pad_left)];
+                if (std::abs((double)hls_val - (double)ref_val) >
+                    TOLERANCE * std::max(1.0, std::abs((double)ref_val))) {
+                    errors++;
+                    if (errors < 10) {
+                        printf("  [ERROR] ROI %d (%d, %d) HLS=%f Ref=%f\n", n, i, j, hls_val, ref_val);
+                    }
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+// Appends 'words' of a frame to an AXI4-Stream, TUSER on the first word and,
+// if 'with_tlast', TLAST on the last one
+void push_axis_frame(hls::stream<axis_word_t>& A_in, const std::vector<mem_word_t>& words,
+                     int count, bool with_tlast) {
+    for (int i = 0; i < count; i++) {
+        axis_word_t word;
+        word.data = words[i];
+        word.keep = -1;
+        word.strb = -1;
+        word.user = (i == 0);
+        word.last = (with_tlast && i == count - 1);
+        word.id = 0;
+        word.dest = 0;
+        A_in.write(word);
+    }
+}
+
+void push_axis_garbage(hls::stream<axis_word_t>& A_in, int count) {
+    for (int i = 0; i < count; i++) {
+        axis_word_t word;
+        word.data = 12345 + i;
+        word.keep = -1;
+        word.strb = -1;
+        word.user = 0;
+        word.last = (i == count - 1);
+        word.id = 0;
+        word.dest = 0;
+        A_in.write(word);
+    }
+}
+
+// Streams a sequence of frames through the free-running top level, one call per
+// frame, with a broken frame in between to check that the loader resynchronises:
+//   garbage, F0, F1 cut short without TLAST, F2, F3 cut short with TLAST, garbage, F4
+// F0, F2 and F4 are checked against compute_golden; every output frame is checked
+// for its TUSER/TLAST/TKEEP framing.
+int run_axis_test(int rows, int columns) {
+    halo_t h = stencil_halo();
+    int halo_rows = TIME_STEPS * (h.top + h.bottom);
+    int halo_columns = TIME_STEPS * (h.left + h.right);
+    if (rows <= halo_rows || columns <= halo_columns) {
+        return 0;
+    }
+
+    const int NUM_FRAMES = 5;
+    int total_elements = rows * columns;
+    int kernel_iterations = (rows - halo_rows) * (columns - halo_columns);
+    int in_words = (total_elements + P - 1) / P;
+    int out_words = (kernel_iterations + P - 1) / P;
+    int last_lanes = kernel_iterations - (out_words - 1) * P;
+
+    printf("[TB] Frame %d x %d, %d frames over AXI4-Stream\n", rows, columns, NUM_FRAMES);
+
+    hls::stream<axis_word_t> A_in;
+    hls::stream<axis_word_t> B_out;
+    std::vector<std::vector<data_t> > Golden(NUM_FRAMES);
+
+    push_axis_garbage(A_in, 3);
+    for (int f = 0; f < NUM_FRAMES; f++) {
+        std::vector<data_t> RAM_in(total_elements);
+        init_input(RAM_in, 37 * f);
+        compute_golden_steps(RAM_in, Golden[f], rows, columns);
+
+        std::vector<mem_word_t> AXI_in(in_words, 0);
+        pack_words(RAM_in, AXI_in);
+        if (f == 1) {
+            push_axis_frame(A_in, AXI_in, (in_words + 1) / 2, false);
+        } else if (f == 3) {
+            push_axis_frame(A_in, AXI_in, (in_words + 1) / 2, true);
+            push_axis_garbage(A_in, 2);
+        } else {
+            push_axis_frame(A_in, AXI_in, in_words, true);
+        }
+    }
+
+    int errors = 0;
+    for (int f = 0; f < NUM_FRAMES; f++) {
+        architecture_top_level_axis(A_in, B_out, rows, columns);
+
+        std::vector<mem_word_t> AXI_out(out_words, 0);
+        for (int i = 0; i < out_words; i++) {
+            axis_word_t word = B_out.read();
+            AXI_out[i] = word.data;
+
+            bool last = (i == out_words - 1);
+            int lanes = last ? last_lanes : P;
+            unsigned long long keep = (lanes * DATA_WIDTH / 8 >= 64) ? ~0ULL
+                                      : (1ULL << (lanes * DATA_WIDTH / 8)) - 1;
+            if ((bool)word.user != (i == 0) || (bool)word.last != last ||
+                word.keep.to_uint64() != keep) {
+                errors++;
+                if (errors < 10) {
+                    printf("  [ERROR] frame %d word %d: TUSER=%d TLAST=%d TKEEP=%llx\n", f, i,
+                           (int)word.user, (int)word.last, (unsigned long long)word.keep.to_uint64());
+                }
+            }
+        }
+        if (f == 1 || f == 3) {
+            continue;
+        }
+
+        std::vector<data_t> RAM_out(kernel_iterations);
+        unpack_words(AXI_out, RAM_out);
+        for (int i = 0; i < kernel_iterations; i++) {
+            data_t ref_val = Golden[f][i];
+            if (std::abs((double)RAM_out[i] - (double)ref_val) >
+                TOLERANCE * std::max(1.0, std::abs((double)ref_val))) {
+                errors++;
+                if (errors < 10) {
+                    printf("  [ERROR] frame %d i=%d HLS=%f Ref=%f\n", f, i, RAM_out[i], ref_val);
+                }
+            }
+        }
+    }
+
+    if (!A_in.empty() || !B_out.empty()) {
+        printf("  [ERROR] words left in the AXI4-Stream FIFOs\n");
+        errors++;
+    }
+    return errors;
+}
+
+#if PARALLEL_FACTOR == 1
+// Runs one frame size through the strip top level with 1..STRIP_UNITS strips.
+// Every strip count has to reproduce the single-unit output bit for bit (the
+// golden model when the frame is too wide for architecture_top_level).
+int run_strip_test(int rows, int columns) {
+    halo_t h = stencil_halo();
+    int halo_rows = TIME_STEPS * (h.top + h.bottom);
+    int halo_columns = TIME_STEPS * (h.left + h.right);
+    if (rows <= halo_rows || columns <= halo_columns) {
+        return 0;
+    }
+
+    int total_elements = rows * columns;
+    int output_columns = columns - halo_columns;
+    int kernel_iterations = (rows - halo_rows) * output_columns;
+
+    std::vector<data_t> RAM_in(total_elements);
+    init_input(RAM_in);
+    std::vector<mem_word_t> AXI_in(total_elements, 0);
+    pack_words(RAM_in, AXI_in);
+
+    // Reference output: one compute unit when the frame fits, else the golden model
+    bool exact = columns <= MAX_COLUMNS;
+    std::vector<data_t> Reference_out(kernel_iterations);
+    if (exact) {
+        std::vector<mem_word_t> AXI_ref(kernel_iterations, 0);
+        top_level_options options;
+        call_top_level(AXI_in.data(), AXI_ref.data(), rows, columns, BOUNDARY_CROP, 0, options);
+        unpack_words(AXI_ref, Reference_out);
+    } else {
+        compute_golden_steps(RAM_in, Reference_out, rows, columns);
+    }
+
+    int errors = 0;
+    for (int strips = 1; strips <= STRIP_UNITS; strips++) {
+        if ((output_columns + strips - 1) / strips + halo_columns > MAX_COLUMNS) {
+            continue;
+        }
+        printf("[TB] Frame %d x %d on %d strips\n", rows, columns, strips);
+
+        std::vector<mem_word_t> AXI_out(kernel_iterations, 0);
+        mem_word_t* A = AXI_in.data();
+        mem_word_t* B = AXI_out.data();
+        architecture_top_level_strips(A, A, A, A, B, B, B, B, rows, columns, strips);
+
+        std::vector<data_t> RAM_out(kernel_iterations);
+        unpack_words(AXI_out, RAM_out);
+        for (int i = 0; i < kernel_iterations; i++) {
+            data_t hls_val = RAM_out[i];
+            data_t ref_val = Reference_out[i];
+            bool match = exact ? (hls_val == ref_val)
+                               : std::abs((double)hls_val - (double)ref_val) <=
+                                     TOLERANCE * std::max(1.0, std::abs((double)ref_val));
+            if (!match) {
+                errors++;
+                if (errors < 10) {
+                    printf("  [ERROR] strips=%d i=%d HLS=%f Ref=%f\n", strips, i, hls_val, ref_val);
+                }
+            }
+        }
+    }
+    return errors;
+}
+#endif
+
+int main() {
+    printf("[TB] Starting Testbench...\n");
+
+    int errors = 0;
+    for (int t = 0; t < NUM_TEST_SIZES; t++) {
+        errors += run_test(TEST_SIZES[t][0], TEST_SIZES[t][1]);
+    }
+
+#ifdef CSIM_THREADED
+    // Production-size frame, only with the threaded C-simulation runtime. MAX_ROWS
+    // only bounds the trip counts, so a taller frame is valid in C-simulation.
+    errors += run_test(LARGE_FRAME_ROWS, MAX_COLUMNS);
+#if ENABLE_ROW_PROGRESS
+    // B rows taken by a consumer thread while the kernel still runs
+    errors += run_row_progress_test(LARGE_FRAME_ROWS, MAX_COLUMNS, 0);
+    errors += run_row_progress_test(64, 513, ((513 + P - 1) / P + 1) * P);
+#endif
+#endif
+
+    // Full-size B for every boundary mode, dense and with a padded row pitch
+    for (int boundary = BOUNDARY_ZERO; boundary <= BOUNDARY_PERIODIC; boundary++) {
+        for (int t = 0; t < NUM_BOUNDARY_TEST_SIZES; t++) {
+            int rows = BOUNDARY_TEST_SIZES[t][0];
+            int columns = BOUNDARY_TEST_SIZES[t][1];
+            int output_pitch = ((columns + P - 1) / P + 1) * P;
+            errors += run_test(rows, columns, boundary, 0);
+            errors += run_test(rows, columns, boundary, output_pitch);
+        }
+    }
+    errors += run_test(12, 64, BOUNDARY_CROP, (64 / P + 1) * P);
+
+#if STENCIL_SHAPE != 6
+    for (int t = 0; t < NUM_TEST_SIZES; t++) {
+        errors += run_gradient_test(TEST_SIZES[t][0], TEST_SIZES[t][1]);
+    }
+#endif
+
+#if ENABLE_STATS
+    for (int t = 0; t < NUM_TEST_SIZES; t++) {
+        errors += run_stats_test(TEST_SIZES[t][0], TEST_SIZES[t][1], BOUNDARY_CROP);
+    }
+    errors += run_stats_test(12, 64, BOUNDARY_CLAMP);
+#if DATA_FORMAT != DATA_FORMAT_FIXED
+    errors += run_stats_test(12, 64, BOUNDARY_CROP, true);
+#endif
+    for (int period = 1; period <= 3; period++) {
+        errors += run_stats_test(12, 64, BOUNDARY_CROP, false, period);
+    }
+#endif
+
+    for (int t = 0; t < NUM_TEST_SIZES; t++) {
+        errors += run_axis_test(TEST_SIZES[t][0], TEST_SIZES[t][1]);
+    }
+
+    for (int t = 0; t < NUM_TEST_SIZES; t++) {
+        errors += run_roi_test(TEST_SIZES[t][0], TEST_SIZES[t][1]);
+    }
+
+    // Resident solver: an odd and an even number of iterations (B comes from
+    // either grid) in every boundary mode, then the early exit
+    for (int boundary = BOUNDARY_CROP; boundary <= BOUNDARY_PERIODIC; boundary++) {
+        for (int t = 0; t < NUM_BOUNDARY_TEST_SIZES; t++) {
+            errors += run_resident_test(BOUNDARY_TEST_SIZES[t][0], BOUNDARY_TEST_SIZES[t][1], boundary, 3, 0.0f);
+            errors += run_resident_test(BOUNDARY_TEST_SIZES[t][0], BOUNDARY_TEST_SIZES[t][1], boundary, 4, 0.0f);
+        }
+        errors += run_resident_test(12, 64, boundary, 100, 1e-4f);
+    }
+    errors += run_resident_test(MAX_ROWS, MAX_COLUMNS, BOUNDARY_CROP, 2, 0.0f);
+    errors += run_resident_test(4 * MAX_ROWS, MAX_COLUMNS / 4, BOUNDARY_CLAMP, 0, 0.0f);
+
+#if PARALLEL_FACTOR == 1
+    for (int t = 0; t < NUM_TEST_SIZES; t++) {
+        errors += run_strip_test(TEST_SIZES[t][0], TEST_SIZES[t][1]);
+    }
+    for (int t = 0; t < NUM_WIDE_TEST_SIZES; t++) {
+        errors += run_strip_test(WIDE_TEST_SIZES[t][0], WIDE_TEST_SIZES[t][1]);
+    }
+#endif
 
     if (errors == 0) {
         printf("\n--- TEST PASSED ---\n");
-        printf("Output size matches: %d pixels\n", KERNEL_ITERATIONS);
+        printf("All %d frame sizes match the golden reference\n", NUM_TEST_SIZES);
     } else {
         printf("\n--- TEST FAILED: %d errors ---\n", errors);
     }
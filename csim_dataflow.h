@@ -0,0 +1,20 @@
+#ifndef CSIM_DATAFLOW_H
+#define CSIM_DATAFLOW_H
+
+// Dataflow hooks of the kernels. Threaded C-simulation (csim_threaded/hls_stream.h)
+// runs every DATAFLOW_PROCESS on its own thread and joins them at the end of the
+// DATAFLOW_REGION, and labels its FIFO report by TOP_LEVEL_REGION and
+// NAME_STREAMS; RELEASE_STORE orders a flag after the data writes it announces
+// to another thread. Everywhere else (HLS, cosim, sequential C-sim) these are
+// plain sequential calls, stores and nothing.
+//
+// Include after hls_stream.h, which defines them first in the threaded build.
+#ifndef DATAFLOW_PROCESS
+#define DATAFLOW_REGION
+#define DATAFLOW_PROCESS(...) __VA_ARGS__
+#define TOP_LEVEL_REGION
+#define NAME_STREAMS(streams, prefix)
+#define RELEASE_STORE(ptr, value) (*(ptr) = (value))
+#endif
+
+#endif
@@ -0,0 +1,524 @@
+#ifndef CSIM_THREADED_HLS_STREAM_H
+#define CSIM_THREADED_HLS_STREAM_H
+
+// --- THREADED C-SIMULATION RUNTIME ---
+// Drop-in replacement for Vitis' hls_stream.h for C-simulation only. Put this
+// directory first on the include path and define CSIM_THREADED:
+//
+//   g++ -std=c++14 -O2 -pthread -DCSIM_THREADED -I csim_threaded -I $XILINX_HLS/include
+//       first_try_cong.cpp cong_testbench.cpp -o csim_threaded_tb
+//
+// The hooks below are defined here first; csim_dataflow.h gives the kernels
+// their sequential versions in every other build.
+//
+// - Every call wrapped in DATAFLOW_PROCESS(...) runs on its own thread. The
+//   DATAFLOW_REGION of the enclosing function joins them before its streams
+//   go out of scope, so nested DATAFLOW/INLINE regions work as in hardware.
+// - hls::stream<T, DEPTH> is a lock-free single-producer/single-consumer ring of
+//   DEPTH elements: a full FIFO blocks its writer, an empty one its reader, so a
+//   FIFO that is too shallow deadlocks here exactly as in cosim. hls::stream<T>
+//   (no depth in the type, e.g. the testbench's streams) stays unbounded.
+// - A watchdog thread reports every stream that is blocked full or empty once no
+//   stream has moved for CSIM_WATCHDOG_SECONDS seconds (environment variable,
+//   default 10, 0 disables) and aborts the simulation.
+// - Every stream counts its reads and writes, its peak occupancy and how many
+//   reads found it empty / writes found it full. With CSIM_FIFO_REPORT=<file>
+//   the counters are written at exit, one row per top level, stream name and
+//   depth (all instances merged), as JSON if the file name ends in .json and CSV
+//   otherwise. The top level is the function that opened the TOP_LEVEL_REGION
+//   the stream was created under ("-" outside one, e.g. the testbench's
+//   streams); DATAFLOW_PROCESS threads inherit it. NAME_STREAMS(array, "tap")
+//   names the elements of a stream array "tap_00", "tap_01", ...
+// - The report is occupancy and stall telemetry of this run, not a FIFO sizing
+//   tool: the threads are scheduled by the OS, not by a clock, so peaks and
+//   blocked counts say which streams ran full or empty here, not which depth
+//   the hardware needs. Minimal depths come from stencil_model --sweep-fifos
+//   (a cycle model that checks for deadlock and added stall) and cosim.
+// - A process that polls empty()/full() (read_nb/write_nb) and finds the stream
+//   unusable backs off like a blocked read/write, and counts as blocked for the
+//   watchdog once it has kept polling, so polling loops neither starve the other
+//   threads nor hide a deadlock.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace csim {
+
+// State of one stream as seen by the watchdog and the FIFO report
+class stream_monitor {
+public:
+    virtual ~stream_monitor() {}
+    virtual const std::string& monitor_top_level() const = 0;
+    virtual const std::string& monitor_name() const = 0;
+    virtual size_t monitor_depth() const = 0;
+    virtual size_t monitor_reads() const = 0;
+    virtual size_t monitor_writes() const = 0;
+    virtual size_t monitor_peak() const = 0;
+    virtual size_t monitor_blocked_reads() const = 0;
+    virtual size_t monitor_blocked_writes() const = 0;
+    virtual bool monitor_reader_blocked() const = 0;
+    virtual bool monitor_writer_blocked() const = 0;
+};
+
+// Counters of all instances of one stream name and depth in one top level
+struct fifo_stats {
+    std::string top_level;
+    std::string name;
+    size_t depth;
+    size_t instances;
+    size_t reads;
+    size_t writes;
+    size_t peak;
+    size_t blocked_reads;
+    size_t blocked_writes;
+};
+
+// Top level whose TOP_LEVEL_REGION the current thread runs in ("" outside one)
+inline const char*& current_top_level() {
+    static thread_local const char* name = "";
+    return name;
+}
+
+class top_level_scope {
+public:
+    explicit top_level_scope(const char* name) : saved_(current_top_level()) {
+        current_top_level() = name;
+    }
+    ~top_level_scope() { current_top_level() = saved_; }
+private:
+    const char* saved_;
+};
+
+// Registry of the live streams, the watchdog and the FIFO report
+class runtime {
+public:
+    static runtime& instance() {
+        // Never destroyed: the detached watchdog thread may still use it at exit
+        static runtime* r = new runtime();
+        return *r;
+    }
+
+    void add(stream_monitor* s) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        streams_.push_back(s);
+    }
+
+    // Renames a registered stream (NAME_STREAMS)
+    void rename(std::string& name, const std::string& new_name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        name = new_name;
+    }
+
+    // A stream going out of scope: keep its counters for the report
+    void remove(stream_monitor* s) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        merge(retired_, s);
+        streams_.erase(std::find(streams_.begin(), streams_.end(), s));
+    }
+
+    // Started by the first dataflow region
+    void start_watchdog() {
+        std::call_once(watchdog_started_, [this]() {
+            const char* env = std::getenv("CSIM_WATCHDOG_SECONDS");
+            int seconds = env ? std::atoi(env) : 10;
+            if (seconds > 0) {
+                std::thread(&runtime::watchdog, this, seconds).detach();
+            }
+        });
+    }
+
+    // Counters of every stream seen so far, live ones included
+    std::vector<fifo_stats> fifo_report() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<fifo_stats> stats = retired_;
+        for (size_t k = 0; k < streams_.size(); k++) {
+            merge(stats, streams_[k]);
+        }
+        return stats;
+    }
+
+    bool write_fifo_report(const char* path) {
+        std::vector<fifo_stats> stats = fifo_report();
+        FILE* f = fopen(path, "w");
+        if (!f) return false;
+
+        size_t length = strlen(path);
+        bool json = length >= 5 && strcmp(path + length - 5, ".json") == 0;
+        if (json) {
+            fprintf(f, "[\n");
+        } else {
+            fprintf(f, "top_level,name,depth,instances,writes,reads,peak_occupancy,"
+                       "blocked_writes,blocked_reads\n");
+        }
+        for (size_t k = 0; k < stats.size(); k++) {
+            const fifo_stats& s = stats[k];
+            if (json) {
+                fprintf(f, "  {\"top_level\": \"%s\", \"name\": \"%s\", \"depth\": %zu, "
+                           "\"instances\": %zu, \"writes\": %zu, \"reads\": %zu, "
+                           "\"peak_occupancy\": %zu, \"blocked_writes\": %zu, \"blocked_reads\": %zu}%s\n",
+                        s.top_level.c_str(), s.name.c_str(), s.depth, s.instances, s.writes, s.reads,
+                        s.peak, s.blocked_writes, s.blocked_reads, k + 1 < stats.size() ? "," : "");
+            } else {
+                fprintf(f, "%s,%s,%zu,%zu,%zu,%zu,%zu,%zu,%zu\n",
+                        s.top_level.c_str(), s.name.c_str(), s.depth, s.instances, s.writes, s.reads,
+                        s.peak, s.blocked_writes, s.blocked_reads);
+            }
+        }
+        if (json) fprintf(f, "]\n");
+        fclose(f);
+        return true;
+    }
+
+private:
+    runtime() {
+        std::atexit(&runtime::report_at_exit);
+    }
+
+    static void report_at_exit() {
+        const char* path = std::getenv("CSIM_FIFO_REPORT");
+        if (!path || !*path) return;
+        if (instance().write_fifo_report(path)) {
+            printf("[CSIM] FIFO report written to %s\n", path);
+        } else {
+            fprintf(stderr, "[CSIM] cannot write the FIFO report to %s\n", path);
+        }
+    }
+
+    static void merge(std::vector<fifo_stats>& stats, const stream_monitor* s) {
+        size_t k = 0;
+        while (k < stats.size() &&
+               !(stats[k].top_level == s->monitor_top_level() && stats[k].name == s->monitor_name() &&
+                 stats[k].depth == s->monitor_depth())) {
+            k++;
+        }
+        if (k == stats.size()) {
+            fifo_stats entry = {s->monitor_top_level(), s->monitor_name(), s->monitor_depth(),
+                                0, 0, 0, 0, 0, 0};
+            stats.push_back(entry);
+        }
+        fifo_stats& e = stats[k];
+        e.instances++;
+        e.reads += s->monitor_reads();
+        e.writes += s->monitor_writes();
+        e.peak = std::max(e.peak, s->monitor_peak());
+        e.blocked_reads += s->monitor_blocked_reads();
+        e.blocked_writes += s->monitor_blocked_writes();
+    }
+
+    void watchdog(int seconds) {
+        size_t last_progress = 0;
+        auto last_change = std::chrono::steady_clock::now();
+        for (;;) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            size_t progress = 0;
+            bool blocked = false;
+            for (size_t k = 0; k < streams_.size(); k++) {
+                progress += streams_[k]->monitor_reads() + streams_[k]->monitor_writes();
+                blocked = blocked || streams_[k]->monitor_reader_blocked() ||
+                          streams_[k]->monitor_writer_blocked();
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (progress != last_progress || !blocked) {
+                last_progress = progress;
+                last_change = now;
+            } else if (now - last_change > std::chrono::seconds(seconds)) {
+                report_deadlock(seconds);
+                std::abort();
+            }
+        }
+    }
+
+    void report_deadlock(int seconds) {
+        fprintf(stderr, "\n[CSIM] DEADLOCK: no stream has moved for %d s. Blocked streams:\n", seconds);
+        for (size_t k = 0; k < streams_.size(); k++) {
+            stream_monitor* s = streams_[k];
+            bool full = s->monitor_writer_blocked();
+            bool empty = s->monitor_reader_blocked();
+            if (!full && !empty) continue;
+
+            size_t occupancy = s->monitor_writes() - s->monitor_reads();
+            char depth[32];
+            if (s->monitor_depth() == 0) {
+                snprintf(depth, sizeof(depth), "unbounded");
+            } else {
+                snprintf(depth, sizeof(depth), "depth %zu", s->monitor_depth());
+            }
+            fprintf(stderr, "  %-24s %-24s %-14s %-5s %zu in FIFO, %zu written, %zu read\n",
+                    s->monitor_top_level().c_str(), s->monitor_name().c_str(), depth, full ? "FULL" : "EMPTY",
+                    occupancy, s->monitor_writes(), s->monitor_reads());
+        }
+        fflush(stderr);
+    }
+
+    std::mutex mutex_;
+    std::vector<stream_monitor*> streams_;
+    std::vector<fifo_stats> retired_;
+    std::once_flag watchdog_started_;
+};
+
+// Back-off while a stream is blocked: spin, then yield, then sleep
+class backoff {
+public:
+    backoff() : spins_(0) {}
+    // Returns true once the wait counts as blocked for the watchdog
+    bool wait() {
+        spins_++;
+        if (spins_ < 64) {
+            std::this_thread::yield();
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(spins_ < 1024 ? 1 : 50));
+        return true;
+    }
+    bool first() const { return spins_ == 1; }
+    void reset() { spins_ = 0; }
+private:
+    unsigned spins_;
+};
+
+// Counter owned by a single thread (the stream's reader or its writer) and read
+// by the watchdog/report
+inline void bump(std::atomic<size_t>& counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// Threads of one DATAFLOW region; joined when the region goes out of scope
+class dataflow_region {
+public:
+    template <class F>
+    void spawn(F process) {
+        runtime::instance().start_watchdog();
+        const char* top_level = current_top_level();
+        threads_.push_back(std::thread([top_level, process]() {
+            current_top_level() = top_level;
+            process();
+        }));
+    }
+
+    ~dataflow_region() {
+        for (size_t k = 0; k < threads_.size(); k++) {
+            threads_[k].join();
+        }
+    }
+
+private:
+    std::vector<std::thread> threads_;
+};
+
+// Names streams[k] "<prefix>_<k>", k on two digits
+template <class S, size_t N>
+void name_streams(S (&streams)[N], const char* prefix) {
+    for (size_t k = 0; k < N; k++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s_%02zu", prefix, k);
+        streams[k].set_name(name);
+    }
+}
+
+} // namespace csim
+
+// Declare after the region's local streams (and any other locals the processes
+// use), so that the threads are joined before those are destroyed
+#define DATAFLOW_REGION csim::dataflow_region csim_dataflow_region_
+#define DATAFLOW_PROCESS(...) csim_dataflow_region_.spawn([&]() { __VA_ARGS__; })
+// First statement of a top level, before its streams: labels them in the report
+#define TOP_LEVEL_REGION csim::top_level_scope csim_top_level_scope_(__func__)
+// After the declaration of a local stream array
+#define NAME_STREAMS(streams, prefix) csim::name_streams(streams, prefix)
+// A flag store that another thread may read with acquire: every write of this
+// thread before it is visible to that thread once it sees the flag
+#define RELEASE_STORE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+
+namespace hls {
+
+template <typename T, int DEPTH = 0> class stream;
+
+template <typename T>
+class stream<T, 0> : public csim::stream_monitor {
+public:
+    stream() : capacity_(0) { init(); }
+    explicit stream(const char* name) : name_(name), capacity_(0) { init(); }
+    virtual ~stream() { csim::runtime::instance().remove(this); }
+
+    T read() {
+        csim::backoff wait;
+        if (capacity_ == 0) {
+            for (;;) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!queue_.empty()) {
+                        T value = queue_.front();
+                        queue_.pop_front();
+                        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                        reader_blocked_.store(false, std::memory_order_relaxed);
+                        return value;
+                    }
+                }
+                if (wait.wait()) reader_blocked_.store(true, std::memory_order_relaxed);
+                if (wait.first()) csim::bump(blocked_reads_);
+            }
+        }
+
+        size_t head = head_.load(std::memory_order_relaxed);
+        while (tail_.load(std::memory_order_acquire) == head) {
+            if (wait.wait()) reader_blocked_.store(true, std::memory_order_relaxed);
+            if (wait.first()) csim::bump(blocked_reads_);
+        }
+        reader_blocked_.store(false, std::memory_order_relaxed);
+        T value = ring_[head % capacity_];
+        head_.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+    void read(T& value) { value = read(); }
+
+    bool read_nb(T& value) {
+        if (empty()) return false;
+        value = read();
+        return true;
+    }
+
+    void write(const T& value) {
+        csim::backoff wait;
+        if (capacity_ == 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(value);
+            tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            if (queue_.size() > peak_.load(std::memory_order_relaxed)) {
+                peak_.store(queue_.size(), std::memory_order_relaxed);
+            }
+            return;
+        }
+
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        while (tail - head_.load(std::memory_order_acquire) == capacity_) {
+            if (wait.wait()) writer_blocked_.store(true, std::memory_order_relaxed);
+            if (wait.first()) csim::bump(blocked_writes_);
+        }
+        writer_blocked_.store(false, std::memory_order_relaxed);
+        ring_[tail % capacity_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+
+        size_t occupancy = tail + 1 - head_.load(std::memory_order_relaxed);
+        if (occupancy > peak_.load(std::memory_order_relaxed)) {
+            peak_.store(occupancy, std::memory_order_relaxed);
+        }
+    }
+
+    bool write_nb(const T& value) {
+        if (full()) return false;
+        write(value);
+        return true;
+    }
+
+    void operator>>(T& value) { read(value); }
+    void operator<<(const T& value) { write(value); }
+
+    // Polled by the reader
+    bool empty() const {
+        bool empty = tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+        if (!empty) {
+            reader_poll_.reset();
+            reader_blocked_.store(false, std::memory_order_relaxed);
+        } else if (reader_poll_.wait()) {
+            reader_blocked_.store(true, std::memory_order_relaxed);
+        }
+        return empty;
+    }
+    // Polled by the writer
+    bool full() const {
+        bool full = capacity_ != 0 && size() == capacity_;
+        if (!full) {
+            writer_poll_.reset();
+            writer_blocked_.store(false, std::memory_order_relaxed);
+        } else if (writer_poll_.wait()) {
+            writer_blocked_.store(true, std::memory_order_relaxed);
+        }
+        return full;
+    }
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    // Only in this runtime, see NAME_STREAMS; before the stream is used
+    void set_name(const char* name) {
+        csim::runtime::instance().rename(name_, name);
+    }
+
+    const std::string& monitor_top_level() const { return top_level_; }
+    const std::string& monitor_name() const { return name_; }
+    size_t monitor_depth() const { return capacity_; }
+    size_t monitor_reads() const { return head_.load(std::memory_order_relaxed); }
+    size_t monitor_writes() const { return tail_.load(std::memory_order_relaxed); }
+    size_t monitor_peak() const { return peak_.load(std::memory_order_relaxed); }
+    size_t monitor_blocked_reads() const { return blocked_reads_.load(std::memory_order_relaxed); }
+    size_t monitor_blocked_writes() const { return blocked_writes_.load(std::memory_order_relaxed); }
+    bool monitor_reader_blocked() const { return reader_blocked_.load(std::memory_order_relaxed); }
+    bool monitor_writer_blocked() const { return writer_blocked_.load(std::memory_order_relaxed); }
+
+protected:
+    stream(const char* name, size_t capacity) : name_(name), capacity_(capacity) { init(); }
+
+private:
+    stream(const stream&);
+    stream& operator=(const stream&);
+
+    void init() {
+        if (name_.empty()) {
+            name_ = "unnamed";
+        }
+        top_level_ = *csim::current_top_level() ? csim::current_top_level() : "-";
+        ring_.resize(capacity_);
+        head_.store(0);
+        tail_.store(0);
+        peak_.store(0);
+        blocked_reads_.store(0);
+        blocked_writes_.store(0);
+        reader_blocked_.store(false);
+        writer_blocked_.store(false);
+        csim::runtime::instance().add(this);
+    }
+
+    std::string top_level_;
+    std::string name_;
+    size_t capacity_;          // 0 = unbounded
+
+    // Bounded: ring indexed by the free-running read/write counts
+    std::vector<T> ring_;
+    alignas(64) std::atomic<size_t> head_;            // elements read (reader side)
+    std::atomic<size_t> blocked_reads_;
+    mutable std::atomic<bool> reader_blocked_;
+    mutable csim::backoff reader_poll_;
+    alignas(64) std::atomic<size_t> tail_;            // elements written (writer side)
+    std::atomic<size_t> peak_;
+    std::atomic<size_t> blocked_writes_;
+    mutable std::atomic<bool> writer_blocked_;
+    mutable csim::backoff writer_poll_;
+
+    // Unbounded
+    std::mutex mutex_;
+    std::deque<T> queue_;
+};
+
+template <typename T, int DEPTH>
+class stream : public stream<T, 0> {
+public:
+    stream() : stream<T, 0>("", DEPTH) {}
+    explicit stream(const char* name) : stream<T, 0>(name, DEPTH) {}
+};
+
+} // namespace hls
+
+#endif
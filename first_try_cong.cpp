@@ -1,202 +1,2333 @@
-#include <stdio.h>  
-#include "ap_int.h"     
-#include "ap_fixed.h" 
+#include <stdio.h>
+#include "ap_int.h"
+#include "ap_fixed.h"
 #include "hls_stream.h"
-#include "hls_math.h"  
+#include "hls_math.h"
+#include "ap_axi_sdata.h"
+#include "pixel_format.h"
+#include "csim_dataflow.h"
+#include "stencil_chain.h"
 
-typedef float data_t;
+// --- BUILD CONFIGURATION ---
+// Pixel format of A and B: -DDATA_FORMAT=N, see pixel_format.h (default float).
+// Pixels moved per clock by every stage (1, 2, 4, 8, 16). Set with -DPARALLEL_FACTOR=P.
+#ifndef PARALLEL_FACTOR
+#define PARALLEL_FACTOR 1
+#endif
+
+// Stencil engine behind stencil_compute. Set with -DSTENCIL_ENGINE=N.
+//   0: splitter/filter chain of Figure 5 (411)
+//   1: single line-buffer process with a 3x3 register window (PARALLEL_FACTOR 1 only)
+#define STENCIL_ENGINE_CHAIN 0
+#define STENCIL_ENGINE_LINE_BUFFER 1
+
+#ifndef STENCIL_ENGINE
+#define STENCIL_ENGINE STENCIL_ENGINE_CHAIN
+#endif
+
+// Stencil shape generated by stencil_network. Set with -DSTENCIL_SHAPE=N.
+//   5: A[i±1][j], A[i][j±1], A[i][j]            (Listing 1 (408))
+//   9: the full 3x3 neighbourhood
+//  13: the radius-2 diamond
+//  6: an asymmetric upwind shape, A[i][j], A[i][j-1], A[i][j-2], A[i-1][j], A[i-2][j], A[i+1][j+1]
+#ifndef STENCIL_SHAPE
+#define STENCIL_SHAPE 5
+#endif
+
+// Stencil time steps applied per DRAM pass (temporal blocking). Set with -DTIME_STEPS=T.
+// Step t works on the grid left by step t-1, so B shrinks by T halos.
+#ifndef TIME_STEPS
+#define TIME_STEPS 1
+#endif
+
+// On-chip performance counters read over s_axilite (see PERFORMANCE COUNTERS).
+// Set with -DENABLE_PERF_COUNTERS=1; with 0 they are not built at all.
+#ifndef ENABLE_PERF_COUNTERS
+#define ENABLE_PERF_COUNTERS 0
+#endif
+
+// Statistics of B computed on the fly and read over s_axilite (see OUTPUT
+// STATISTICS). Set with -DENABLE_STATS=1; with 0 they are not built at all.
+#ifndef ENABLE_STATS
+#define ENABLE_STATS 0
+#endif
+
+// Number of complete B rows published in DRAM while B is written (see ROW
+// PROGRESS). Set with -DENABLE_ROW_PROGRESS=1.
+#ifndef ENABLE_ROW_PROGRESS
+#define ENABLE_ROW_PROGRESS 0
+#endif
+
+#if ENABLE_ROW_PROGRESS
+#include "hls_burst_maxi.h"
+#endif
+
+#if STENCIL_ENGINE == STENCIL_ENGINE_LINE_BUFFER && PARALLEL_FACTOR != 1
+#error "The line-buffer engine moves one pixel per clock, build it with PARALLEL_FACTOR=1"
+#endif
+
+// data_t is what the streams and FIFOs carry, acc_t what compute_kernel works in
+typedef active_format::storage_t data_t;
+typedef active_format::acc_t acc_t;
+
+const int P = PARALLEL_FACTOR;
+const int DATA_WIDTH = active_format::WIDTH;
+
+// P pixels packed in one AXI word on gmem0/gmem1 (pixel k in bits W*k+W-1..W*k)
+typedef ap_uint<DATA_WIDTH * PARALLEL_FACTOR> mem_word_t;
+
+// P pixels travelling together through the splitter/filter/compute streams
+struct data_vec_t {
+    data_t lane[PARALLEL_FACTOR];
+};
 
 // --- CONSTANTS FROM INPUT 1 ---
-const int ROWS = 16;
-const int COLUMNS = 1024; //II A (408)
-const int TOTAL_ELEMENTS = ROWS * COLUMNS;
+// The grid size is a runtime argument (rows, columns) of the top level.
+// MAX_COLUMNS is the widest grid one build supports: it sizes the line-buffer
+// FIFOs. Nothing is sized by the height, so rows has no upper bound; MAX_ROWS
+// only sets the trip counts of the reports and the m_axi depths, which are
+// what cosim allocates, so cosim frames stay within it.
+// Valid runtime sizes: rows > TIME_STEPS*HALO_ROWS and
+// TIME_STEPS*HALO_COLUMNS < columns <= MAX_COLUMNS (3..MAX for one 5-point step).
+const int MAX_ROWS = 16;
+const int MAX_COLUMNS = 1024; //II A (408)
+const int MAX_TOTAL_ELEMENTS = MAX_ROWS * MAX_COLUMNS;
+
+// --- STENCIL DESCRIPTION ---
+// A stencil is a constexpr list of 2D offsets (di, dj): B[i][j] is computed from
+// A[i+di][j+dj] for every listed point. Everything in the splitter/filter/FIFO
+// network (stage order, filter domains, FIFO depths and storage) is derived from
+// this list at compile time by the helpers below and in the STENCIL GENERATOR.
+template <int... OFFSETS>
+struct stencil_points {
+    static const int size = sizeof...(OFFSETS) / 2;
+
+    static constexpr int value(int n) {
+        const int offsets[] = {OFFSETS...};
+        return offsets[n];
+    }
+    static constexpr int di(int k) { return value(2 * k); }
+    static constexpr int dj(int k) { return value(2 * k + 1); }
+};
+
+// res_0..res_3 of Listing 1 (408) in order, centre last
+typedef stencil_points<0,-1,  0,1,  -1,0,  1,0,  0,0> five_point_stencil;
+
+typedef stencil_points<0,-1,  0,1,  -1,0,  1,0,
+                       -1,-1, -1,1,  1,-1, 1,1,  0,0> nine_point_stencil;
+
+typedef stencil_points<0,-1,  0,1,  -1,0,  1,0,
+                       0,-2,  0,2,  -2,0,  2,0,
+                       -1,-1, -1,1,  1,-1, 1,1,  0,0> thirteen_point_stencil;
+
+typedef stencil_points<0,-1,  0,-2,  -1,0,  -2,0,  1,1,  0,0> upwind_stencil;
+
+#if STENCIL_SHAPE == 5
+typedef five_point_stencil active_points;
+#elif STENCIL_SHAPE == 9
+typedef nine_point_stencil active_points;
+#elif STENCIL_SHAPE == 13
+typedef thirteen_point_stencil active_points;
+#elif STENCIL_SHAPE == 6
+typedef upwind_stencil active_points;
+#else
+#error "Unknown STENCIL_SHAPE"
+#endif
+
+// Halo = how far the stencil reaches above/below/left/right of B[i][j].
+// B is defined on rows halo_top..rows-1-halo_bottom, columns halo_left..columns-1-halo_right.
+template <class Points> constexpr int stencil_halo_top() {
+    int halo = 0;
+    for (int k = 0; k < Points::size; k++) {
+        if (-Points::di(k) > halo) halo = -Points::di(k);
+    }
+    return halo;
+}
+
+template <class Points> constexpr int stencil_halo_bottom() {
+    int halo = 0;
+    for (int k = 0; k < Points::size; k++) {
+        if (Points::di(k) > halo) halo = Points::di(k);
+    }
+    return halo;
+}
+
+template <class Points> constexpr int stencil_halo_left() {
+    int halo = 0;
+    for (int k = 0; k < Points::size; k++) {
+        if (-Points::dj(k) > halo) halo = -Points::dj(k);
+    }
+    return halo;
+}
+
+template <class Points> constexpr int stencil_halo_right() {
+    int halo = 0;
+    for (int k = 0; k < Points::size; k++) {
+        if (Points::dj(k) > halo) halo = Points::dj(k);
+    }
+    return halo;
+}
+
+// Position of point (di, dj) in the list, -1 if the stencil does not use it
+template <class Points> constexpr int stencil_point_index(int di, int dj) {
+    int index = -1;
+    for (int k = 0; k < Points::size; k++) {
+        if (Points::di(k) == di && Points::dj(k) == dj) index = k;
+    }
+    return index;
+}
+
+const int HALO_TOP = stencil_halo_top<active_points>();
+const int HALO_BOTTOM = stencil_halo_bottom<active_points>();
+const int HALO_LEFT = stencil_halo_left<active_points>();
+const int HALO_RIGHT = stencil_halo_right<active_points>();
+const int HALO_ROWS = HALO_TOP + HALO_BOTTOM;
+const int HALO_COLUMNS = HALO_LEFT + HALO_RIGHT;
 
-const int FIFO_0_DEPTH = 1023;
-const int FIFO_1_DEPTH = 4; 
-const int FIFO_2_DEPTH = 4; 
-const int FIFO_3_DEPTH = 1023; //TABLE 3 (413)
+const int MAX_KERNEL_ROWS = MAX_ROWS - HALO_ROWS;
+const int MAX_KERNEL_COLUMNS = MAX_COLUMNS - HALO_COLUMNS;
+const int MAX_KERNEL_ITERATIONS = MAX_KERNEL_ROWS * MAX_KERNEL_COLUMNS;
 
-const int KERNEL_ROWS = ROWS - 2; 
-const int KERNEL_COLUMNS = COLUMNS - 2; 
-const int KERNEL_ITERATIONS = KERNEL_ROWS * KERNEL_COLUMNS;
+// Size of B after TIME_STEPS steps, as written by store_output
+const int OUTPUT_HALO_ROWS = TIME_STEPS * HALO_ROWS;
+const int OUTPUT_HALO_COLUMNS = TIME_STEPS * HALO_COLUMNS;
+const int MAX_OUTPUT_ELEMENTS = (MAX_ROWS - OUTPUT_HALO_ROWS) * (MAX_COLUMNS - OUTPUT_HALO_COLUMNS);
+
+const int MAX_TOTAL_WORDS = (MAX_TOTAL_ELEMENTS + P - 1) / P;
+const int MAX_KERNEL_WORDS = (MAX_KERNEL_ITERATIONS + P - 1) / P;
+const int MAX_OUTPUT_WORDS = (MAX_OUTPUT_ELEMENTS + P - 1) / P;
+
+// Number of P-pixel words needed for n pixels (the last word may be partial)
+int words_for(int n) {
+    return (n + P - 1) / P;
+}
+
+// --- BOUNDARY MODES ---
+// Runtime argument 'boundary' of architecture_top_level:
+//   BOUNDARY_CROP      B is the interior only, (rows-OUTPUT_HALO_ROWS) x (columns-OUTPUT_HALO_COLUMNS)
+//   BOUNDARY_ZERO      pixels outside A are 0
+//   BOUNDARY_CLAMP     outside pixels repeat the nearest edge pixel
+//   BOUNDARY_MIRROR    A is reflected about its edge pixels (-1 -> 1, n -> n-2)
+//   BOUNDARY_PERIODIC  A wraps around (-1 -> n-1, n -> 0)
+// In every mode but crop load_input streams A padded by OUTPUT_HALO_ROWS rows and
+// OUTPUT_HALO_COLUMNS columns, split as the stencil reaches (BOUNDARY_PAD_TOP/LEFT
+// before the frame), so the unchanged network returns a full rows x columns B.
+// The border is applied once to A, not again after every time step.
+#define BOUNDARY_CROP 0
+#define BOUNDARY_ZERO 1
+#define BOUNDARY_CLAMP 2
+#define BOUNDARY_MIRROR 3
+#define BOUNDARY_PERIODIC 4
+
+const int BOUNDARY_PAD_TOP = TIME_STEPS * HALO_TOP;
+const int BOUNDARY_PAD_LEFT = TIME_STEPS * HALO_LEFT;
+
+// Grid seen by the network for a rows x columns A
+int grid_rows(int rows, int boundary) {
+    return (boundary == BOUNDARY_CROP) ? rows : rows + OUTPUT_HALO_ROWS;
+}
+
+int grid_columns(int columns, int boundary) {
+    return (boundary == BOUNDARY_CROP) ? columns : columns + OUTPUT_HALO_COLUMNS;
+}
+
+// Index into 0..n-1 that pixel i (up to one pad outside the frame) is read from,
+// or -1 for a zero pixel
+int boundary_index(int i, int n, int boundary) {
+    #pragma HLS INLINE
+    if (i >= 0 && i < n) return i;
+    switch (boundary) {
+    case BOUNDARY_CLAMP:    return (i < 0) ? 0 : n - 1;
+    case BOUNDARY_MIRROR:   return (i < 0) ? -i : 2 * (n - 1) - i;
+    case BOUNDARY_PERIODIC: return (i < 0) ? i + n : i - n;
+    default:                return -1;
+    }
+}
+
+// --- PERFORMANCE COUNTERS ---
+// With ENABLE_PERF_COUNTERS every process of the network polls its streams
+// (empty()/full()) instead of blocking on them, so each pipelined iteration is
+// one clock cycle that either moves a word (busy) or cannot (stall), and at the
+// end it sends its busy and stall counts on its own perf_stream_t. perf_collect
+// gathers them into the s_axilite array perf_counters of architecture_top_level:
+//
+//   PERF_TOTAL_CYCLES        cycles from start until store_output is done
+//   PERF_LOAD_BUSY           words read on gmem0
+//   PERF_LOAD_BACKPRESSURE   cycles perf_load_probe waited on a full input_stream
+//   PERF_GMEM0_STALL         cycles perf_load_probe waited on load_input (its span - busy - backpressure)
+//   PERF_STORE_BUSY          words of B taken from the network
+//   PERF_STORE_STARVED       cycles perf_store_probe waited on the network
+//   PERF_GMEM1_STALL         cycles the store side waited on gmem1 (total - busy - starved)
+//   perf_step_counter(t, p)  busy, then stall cycles of process p of time step t:
+//                            p = 2s / 2s+1 for the splitter / filter of stage s,
+//                            PERF_COMPUTE and PERF_LAST_SPLITTER; the line-buffer
+//                            engine uses p = 0 for the line buffer and reports 0
+//                            for the other chain processes
+//
+// The m_axi loops of load_input/store_output stay unconditional and blocking as
+// in the production build, since a polled access in a pipelined loop stops burst
+// inference. The probes, two small stages between them and the network, count
+// the backpressure and starvation instead, and the gmem stalls are derived from
+// the spans perf_cycle_counter measures from the done tokens of perf_load_probe
+// and store_output.
+// The perf build is a diagnostic build, not the production datapath: the
+// polling processes and the probes schedule differently from the blocking ones,
+// so its cycle counts are close to, not equal to, those of the production
+// kernel. In C simulation the cycle and stall counts are loop iterations, not
+// clock cycles; only the busy counts are meaningful there.
+// Without ENABLE_PERF_COUNTERS perf_stream_t is an empty struct, PERF_STALLED is
+// false and nothing of this is synthesised.
+typedef ap_uint<32> perf_count_t;
+
+#if ENABLE_PERF_COUNTERS
+typedef hls::stream<perf_count_t, 2> perf_stream_t;
+
+// True, and one more stall cycle counted, when the process cannot advance this cycle
+#define PERF_STALLED(ready, stall) (!(ready) && (++(stall), true))
+#else
+struct perf_stream_t {};
+
+#define PERF_STALLED(ready, stall) false
+#endif
+
+const int PERF_COMPUTE = 2 * active_points::size;
+const int PERF_LAST_SPLITTER = 2 * active_points::size + 1;
+const int PERF_STEP_PROCESSES = 2 * active_points::size + 2;
+
+const int PERF_TOTAL_CYCLES = 0;
+const int PERF_LOAD_BUSY = 1;
+const int PERF_LOAD_BACKPRESSURE = 2;
+const int PERF_GMEM0_STALL = 3;
+const int PERF_STORE_BUSY = 4;
+const int PERF_STORE_STARVED = 5;
+const int PERF_GMEM1_STALL = 6;
+const int PERF_STEP_COUNTERS_BASE = 7;
+const int NUM_PERF_COUNTERS = PERF_STEP_COUNTERS_BASE + 2 * TIME_STEPS * PERF_STEP_PROCESSES;
+
+constexpr int perf_step_counter(int step, int process) {
+    return PERF_STEP_COUNTERS_BASE + 2 * (step * PERF_STEP_PROCESSES + process);
+}
+
+void perf_report(perf_stream_t& perf, perf_count_t busy, perf_count_t stall) {
+#if ENABLE_PERF_COUNTERS
+    perf.write(busy);
+    perf.write(stall);
+#else
+    (void)perf;
+    (void)busy;
+    (void)stall;
+#endif
+}
+
+// Token sent by perf_load_probe/store_output once their last word is done
+void perf_done(perf_stream_t& done) {
+#if ENABLE_PERF_COUNTERS
+    done.write(1);
+#else
+    (void)done;
+#endif
+}
+
+data_t bits_to_data(ap_uint<DATA_WIDTH> bits) {
+    return active_format::from_bits(bits);
+}
+
+ap_uint<DATA_WIDTH> data_to_bits(data_t value) {
+    return active_format::to_bits(value);
+}
+
+data_vec_t unpack_word(mem_word_t word) {
+    #pragma HLS INLINE
+    data_vec_t temp;
+    for (int l = 0; l < P; l++) {
+        #pragma HLS UNROLL
+        temp.lane[l] = bits_to_data(word.range(DATA_WIDTH * l + DATA_WIDTH - 1, DATA_WIDTH * l));
+    }
+    return temp;
+}
+
+mem_word_t pack_word(data_vec_t temp) {
+    #pragma HLS INLINE
+    mem_word_t word;
+    for (int l = 0; l < P; l++) {
+        #pragma HLS UNROLL
+        word.range(DATA_WIDTH * l + DATA_WIDTH - 1, DATA_WIDTH * l) = data_to_bits(temp.lane[l]);
+    }
+    return word;
+}
 
 // --- LOAD MODULE ---
-void load_input(data_t* in_mem, hls::stream<data_t>& in_stream) {
-    for (int i = 0; i < TOTAL_ELEMENTS; i++) {
+// A as it is, P pixels per clock (BOUNDARY_CROP)
+void load_dense(mem_word_t* in_mem, hls::stream<data_vec_t>& in_stream, int rows, int columns) {
+    int total_words = words_for(rows * columns);
+    for (int i = 0; i < total_words; i++) {
         #pragma HLS PIPELINE II=1
-        data_t temp = in_mem[i];
-        in_stream.write(temp);
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+        in_stream.write(unpack_word(in_mem[i]));
+    }
+}
+
+// A padded for 'boundary', one padded pixel per clock. Padded row pr is
+// gathered from row boundary_index(pr - BOUNDARY_PAD_TOP) of A into one row
+// buffer while row pr-1 is sent from the other one.
+void load_padded(mem_word_t* in_mem, hls::stream<data_vec_t>& in_stream,
+                 int rows, int columns, int boundary) {
+    data_t row_buf_0[MAX_COLUMNS];
+    data_t row_buf_1[MAX_COLUMNS];
+    #pragma HLS ARRAY_PARTITION variable=row_buf_0 cyclic factor=P
+    #pragma HLS ARRAY_PARTITION variable=row_buf_1 cyclic factor=P
+    bool zero_row_0 = false;
+    bool zero_row_1 = false;
+
+    int padded_rows = rows + OUTPUT_HALO_ROWS;
+    int padded_columns = columns + OUTPUT_HALO_COLUMNS;
+    data_vec_t vec;
+    int lane = 0;
+
+    for (int pr = 0; pr <= padded_rows; pr++) {
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_ROWS+1
+        // Row pr goes to row_buf_1 when odd, row pr-1 is sent from the other buffer
+        bool fill_1 = pr & 1;
+        bool fill = pr < padded_rows;
+        bool send = pr > 0;
+        bool zero_row = fill_1 ? zero_row_0 : zero_row_1;
+
+        int src_row = fill ? boundary_index(pr - BOUNDARY_PAD_TOP, rows, boundary) : -1;
+        int first_pixel = src_row * columns;
+        int first_word = first_pixel / P;
+        int fill_words = (src_row < 0) ? 0 : (first_pixel + columns - 1) / P - first_word + 1;
+        if (fill_1) {
+            zero_row_1 = src_row < 0;
+        } else {
+            zero_row_0 = src_row < 0;
+        }
+
+        int send_pixels = send ? padded_columns : 0;
+        int steps = (fill_words > send_pixels) ? fill_words : send_pixels;
+        bool last_row = pr == padded_rows;
+
+        int w = 0;
+        int pc = 0;
+        for (int k = 0; k < steps; k++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT max=MAX_COLUMNS+1
+            #pragma HLS DEPENDENCE variable=row_buf_0 inter false
+            #pragma HLS DEPENDENCE variable=row_buf_1 inter false
+            bool sending = pc < send_pixels;
+            bool flush = sending && (lane == P - 1 || (last_row && pc == padded_columns - 1));
+
+            if (w < fill_words) {
+                data_vec_t word = unpack_word(in_mem[first_word + w]);
+                int c0 = (first_word + w) * P - first_pixel;
+                for (int l = 0; l < P; l++) {
+                    #pragma HLS UNROLL
+                    int c = c0 + l;
+                    if (c >= 0 && c < columns) {
+                        if (fill_1) {
+                            row_buf_1[c] = word.lane[l];
+                        } else {
+                            row_buf_0[c] = word.lane[l];
+                        }
+                    }
+                }
+                w++;
+            }
+
+            if (sending) {
+                int c = boundary_index(pc - BOUNDARY_PAD_LEFT, columns, boundary);
+                data_t pixel = bits_to_data(0);
+                if (!zero_row && c >= 0) {
+                    pixel = fill_1 ? row_buf_0[c] : row_buf_1[c];
+                }
+                vec.lane[lane] = pixel;
+                if (flush) {
+                    in_stream.write(vec);
+                    lane = 0;
+                } else {
+                    lane++;
+                }
+                pc++;
+            }
+        }
+    }
+}
+
+// Streams the grid the network works on: A for BOUNDARY_CROP, else A padded
+void load_input(mem_word_t* in_mem, hls::stream<data_vec_t>& in_stream,
+                int rows, int columns, int boundary) {
+    if (boundary == BOUNDARY_CROP) {
+        load_dense(in_mem, in_stream, rows, columns);
+    } else {
+        load_padded(in_mem, in_stream, rows, columns, boundary);
     }
 }
 
 // --- STORE MODULE ---
-void store_output(hls::stream<data_t>& out_stream, data_t* out_mem) {
-    for (int i = 0; i < KERNEL_ITERATIONS; i++) {
+// B packed densely, P pixels per clock
+void store_dense(hls::stream<data_vec_t>& out_stream, mem_word_t* out_mem,
+                 int output_rows, int output_columns) {
+    int output_words = words_for(output_rows * output_columns);
+    for (int i = 0; i < output_words; i++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_OUTPUT_WORDS
+        out_mem[i] = pack_word(out_stream.read());
+    }
+}
+
+// B row r from pixel r*output_pitch on, one pixel per clock. The network's
+// words run across rows, so they are re-packed to start every row on a word.
+void store_pitched(hls::stream<data_vec_t>& out_stream, mem_word_t* out_mem,
+                   int output_rows, int output_columns, int output_pitch) {
+    int output_elements = output_rows * output_columns;
+    int pitch_words = output_pitch / P;
+    data_vec_t in_vec;
+    data_vec_t out_vec;
+    int in_lane = 0;
+    int out_lane = 0;
+    int r = 0;
+    int c = 0;
+    for (int n = 0; n < output_elements; n++) {
         #pragma HLS PIPELINE II=1
-        data_t temp = out_stream.read();
-        out_mem[i] = temp;
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_OUTPUT_ELEMENTS
+        if (in_lane == 0) in_vec = out_stream.read();
+
+        out_vec.lane[out_lane] = in_vec.lane[in_lane];
+        in_lane = (in_lane == P - 1) ? 0 : in_lane + 1;
+
+        if (out_lane == P - 1 || c == output_columns - 1) {
+            out_mem[r * pitch_words + c / P] = pack_word(out_vec);
+            out_lane = 0;
+        } else {
+            out_lane++;
+        }
+
+        if (c == output_columns - 1) {
+            c = 0;
+            r++;
+        } else {
+            c++;
+        }
+    }
+}
+
+// --- ROW PROGRESS ---
+// With ENABLE_ROW_PROGRESS architecture_top_level takes row_progress, one int in
+// DRAM on gmem1 (the bundle of B). store_output sets it to 0 before the first
+// write of B and to r after row r-1 of B is written, so a consumer can start on
+// the first rows while the rest are still computed (see stencil_progress.h).
+// Ordering is enforced, not assumed: B is then an hls::burst_maxi port, every
+// row is one explicit write_request/write burst, and write_response() blocks
+// until the BRESP of that burst has been consumed. Only then is the counter
+// written, so a reader who sees row_progress >= r (through an uncached or
+// freshly synced view of the buffers) sees rows 0..r-1 of B complete. The
+// request covers exactly the words of the row; cosim hangs on a burst that
+// writes fewer or more words than it requested, and the testbench checks that
+// the words between pitched rows stay untouched. In the threaded C-sim the
+// counter is stored with release ordering (RELEASE_STORE), which pairs with the
+// acquire of stencil_rows_done.
+// The counter only grows and ends at output_rows, also when write_output is off.
+// Every row costs a burst round trip, some tens of cycles; without
+// ENABLE_ROW_PROGRESS B is a plain pointer written by store_dense/store_pitched
+// as one loop.
+#if ENABLE_ROW_PROGRESS
+typedef hls::burst_maxi<mem_word_t> b_port_t;
+#else
+typedef mem_word_t* b_port_t;
+#endif
+
+#if ENABLE_ROW_PROGRESS
+void store_rows(hls::stream<data_vec_t>& out_stream, b_port_t out_mem,
+                int output_rows, int output_columns, int output_pitch,
+                volatile int* row_progress) {
+    int pitch_words = output_pitch / P;
+    int next_word = 0; // dense: first word not written yet
+    data_vec_t in_vec;
+    int in_lane = 0;   // pitched: next lane of in_vec
+
+    for (int r = 0; r < output_rows; r++) {
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_ROWS
+        if (output_pitch == 0) {
+            // The words up to the last pixel of row r; a word shared with row
+            // r+1 already holds its pixels as well, so a row inside that word
+            // has no words of its own
+            int end_word = words_for((r + 1) * output_columns);
+            if (end_word > next_word) {
+                out_mem.write_request(next_word, end_word - next_word);
+                for (int w = next_word; w < end_word; w++) {
+                    #pragma HLS PIPELINE II=1
+                    #pragma HLS LOOP_TRIPCOUNT max=MAX_COLUMNS/PARALLEL_FACTOR+1
+                    out_mem.write(pack_word(out_stream.read()));
+                }
+                out_mem.write_response();
+            }
+            next_word = end_word;
+        } else {
+            // As store_pitched, one row: words r*pitch_words on
+            data_vec_t out_vec;
+            int out_lane = 0;
+            out_mem.write_request(r * pitch_words, words_for(output_columns));
+            for (int c = 0; c < output_columns; c++) {
+                #pragma HLS PIPELINE II=1
+                #pragma HLS LOOP_TRIPCOUNT max=MAX_COLUMNS
+                if (in_lane == 0) in_vec = out_stream.read();
+
+                out_vec.lane[out_lane] = in_vec.lane[in_lane];
+                in_lane = (in_lane == P - 1) ? 0 : in_lane + 1;
+
+                if (out_lane == P - 1 || c == output_columns - 1) {
+                    out_mem.write(pack_word(out_vec));
+                    out_lane = 0;
+                } else {
+                    out_lane++;
+                }
+            }
+            out_mem.write_response();
+        }
+        RELEASE_STORE(row_progress, r + 1);
     }
 }
+#endif
+
+// Writes B, output_rows x output_columns: dense when output_pitch is 0, else
+// every row at a multiple of output_pitch pixels. Nothing is read or written
+// when write_output is false (only the statistics of B are wanted).
+void store_output(hls::stream<data_vec_t>& out_stream, b_port_t out_mem,
+                  int rows, int columns, int boundary, int output_pitch, bool write_output,
+                  perf_stream_t& store_done
+#if ENABLE_ROW_PROGRESS
+                  , volatile int* row_progress
+#endif
+                  ) {
+    int output_rows = grid_rows(rows, boundary) - OUTPUT_HALO_ROWS;
+    int output_columns = grid_columns(columns, boundary) - OUTPUT_HALO_COLUMNS;
+#if ENABLE_ROW_PROGRESS
+    RELEASE_STORE(row_progress, 0);
+    if (!write_output) {
+        RELEASE_STORE(row_progress, output_rows);
+    } else {
+        store_rows(out_stream, out_mem, output_rows, output_columns, output_pitch, row_progress);
+    }
+#else
+    if (write_output && output_pitch == 0) {
+        store_dense(out_stream, out_mem, output_rows, output_columns);
+    } else if (write_output) {
+        store_pitched(out_stream, out_mem, output_rows, output_columns, output_pitch);
+    }
+#endif
+    perf_done(store_done);
+}
+
+#if ENABLE_PERF_COUNTERS
+// --- PERF PROBES ---
+// Forward total_words words unchanged between a memory loop and the network,
+// polling both streams, so the blocking m_axi loops keep their bursts while
+// the backpressure of the network (load side) and its starvation (store side)
+// are still counted cycle by cycle.
+void perf_load_probe(hls::stream<data_vec_t>& load_stream, hls::stream<data_vec_t>& in_stream,
+                     int total_words, perf_stream_t& perf, perf_stream_t& load_done) {
+    perf_count_t backpressure = 0;
+    for (int i = 0; i < total_words; ) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+        if (PERF_STALLED(!in_stream.full(), backpressure)) continue;
+        data_vec_t word;
+        if (!load_stream.read_nb(word)) continue;
+        in_stream.write(word);
+        i++;
+    }
+    perf_report(perf, total_words, backpressure);
+    perf_done(load_done);
+}
+
+void perf_store_probe(hls::stream<data_vec_t>& network_stream, hls::stream<data_vec_t>& out_stream,
+                      int total_words, perf_stream_t& perf) {
+    perf_count_t starved = 0;
+    for (int i = 0; i < total_words; ) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_OUTPUT_WORDS
+        if (out_stream.full()) continue;
+        if (PERF_STALLED(!network_stream.empty(), starved)) continue;
+        out_stream.write(network_stream.read());
+        i++;
+    }
+    perf_report(perf, total_words, starved);
+}
+#endif
 
 // --- CORE LOGIC MODULES (UNCHANGED FROM INPUT 1) ---
 
-template <int T_TOTAL_ELEMENTS>
-void data_splitter(hls::stream<data_t> &in,
-                   hls::stream<data_t> &out_to_fifo,
-                   hls::stream<data_t> &out_to_filter) { //FIG 5 (411)
+void data_splitter(hls::stream<data_vec_t> &in,
+                   hls::stream<data_vec_t> &out_to_fifo,
+                   hls::stream<data_vec_t> &out_to_filter,
+                   int rows, int columns, perf_stream_t& perf) { //FIG 5 (411)
 
-    for (int i = 0; i < T_TOTAL_ELEMENTS; i++) {
+    int total_words = words_for(rows * columns);
+    perf_count_t stall = 0;
+    for (int i = 0; i < total_words; ) {
         #pragma HLS PIPELINE II=1
-        data_t temp = in.read();
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+        if (PERF_STALLED(!in.empty() && !out_to_fifo.full() && !out_to_filter.full(), stall)) continue;
+        data_vec_t temp = in.read();
         out_to_fifo.write(temp);
         out_to_filter.write(temp);
+        i++;
     }
+    perf_report(perf, total_words, stall);
 }
 
-template <int T_ROWS, int T_COLUMNS,
-          int T_ROW_START, int T_ROW_END,
-          int T_COL_START, int T_COL_END>
-void data_filter(hls::stream<data_t>& in,
-                 hls::stream<data_t>& out) { //FIG 5 (411)
+// The domain D_Ax of a filter is rows T_ROW_START..rows-1-T_ROW_END_MARGIN and
+// columns T_COL_START..columns-1-T_COL_END_MARGIN, so it follows the runtime size.
+// The row/column loops are flattened by hand: with runtime bounds a pipelined
+// inner loop would lose cycles at every row change.
+//
+// With P lanes a word may hold pixels of two rows, so each lane gets its own
+// (i, j) and the in-domain lanes are packed into full output words through the
+// 'pending' buffer. Every filter produces the same packed sequence, so lane k of
+// all five filter outputs refers to the same output pixel B[i][j].
+template <int T_ROW_START, int T_ROW_END_MARGIN,
+          int T_COL_START, int T_COL_END_MARGIN>
+void data_filter(hls::stream<data_vec_t>& in,
+                 hls::stream<data_vec_t>& out,
+                 int rows, int columns, perf_stream_t& perf) { //FIG 5 (411)
 
-    for (int i = 0; i < T_ROWS; i++) {
-        for (int j = 0; j < T_COLUMNS; j++) {
-            #pragma HLS PIPELINE II=1
-            data_t data_in = in.read();
+    int total_words = words_for(rows * columns);
+    int row_end = rows - 1 - T_ROW_END_MARGIN;
+    int col_end = columns - 1 - T_COL_END_MARGIN;
+    int i = 0; // (i, j) of lane 0 of the current word
+    int j = 0;
+
+    data_t pending[2 * PARALLEL_FACTOR];
+    #pragma HLS ARRAY_PARTITION variable=pending complete
+    int count = 0;
+    perf_count_t stall = 0;
 
+    for (int n = 0; n < total_words; ) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+        if (PERF_STALLED(!in.empty() && !out.full(), stall)) continue;
+        data_vec_t data_in = in.read();
+
+        int pos = count;
+        for (int l = 0; l < P; l++) {
+            #pragma HLS UNROLL
             // Έλεγχος αν το (i, j) ανήκει στο D_Ax αυτού του φίλτρου
-            bool in_domain = (i >= T_ROW_START && i <= T_ROW_END &&
-                              j >= T_COL_START && j <= T_COL_END);
+            // (padding lanes after the last pixel have i == rows and are dropped)
+            bool in_domain = (i >= T_ROW_START && i <= row_end &&
+                              j >= T_COL_START && j <= col_end);
 
             if (in_domain) {
-                out.write(data_in);
+                pending[pos] = data_in.lane[l];
+                pos++;
+            }
+
+            if (j == columns - 1) {
+                j = 0;
+                i++;
+            } else {
+                j++;
+            }
+        }
+
+        if (pos >= P) {
+            data_vec_t data_out;
+            for (int l = 0; l < P; l++) {
+                #pragma HLS UNROLL
+                data_out.lane[l] = pending[l];
+                pending[l] = pending[l + P];
             }
+            out.write(data_out);
+            count = pos - P;
+        } else {
+            count = pos;
         }
+        n++;
     }
+
+    // Flush the last, partially filled word
+    if (count > 0) {
+        data_vec_t data_out;
+        for (int l = 0; l < P; l++) {
+            #pragma HLS UNROLL
+            data_out.lane[l] = pending[l];
+        }
+        out.write(data_out);
+    }
+    perf_report(perf, total_words, stall);
 }
 
-template <int T_ITERATIONS>
-void compute_kernel(hls::stream<data_t>& in_1, // A[i+1][j]
-                    hls::stream<data_t>& in_2, // A[i][j+1]
-                    hls::stream<data_t>& in_3, // A[i][j]
-                    hls::stream<data_t>& in_4, // A[i][j-1]
-                    hls::stream<data_t>& in_5, // A[i-1][j]
-                    hls::stream<data_t>& out_B) {
+// Combiner of Listing 1 (408), Listing 2 (409): sum of the squared differences
+// between the centre A[i][j] and every other stencil point, in list order.
+// Works on the widened acc_t values.
+template <class Points>
+struct sum_sq_diff {
+    acc_t operator()(const acc_t taps[Points::size]) const {
+        #pragma HLS INLINE
+        int centre = 0;
+        for (int k = 0; k < Points::size; k++) {
+            if (Points::di(k) == 0 && Points::dj(k) == 0) centre = k;
+        }
+
+        acc_t a00 = taps[centre];
+        acc_t b_val = 0;
+        for (int k = 0; k < Points::size; k++) {
+            #pragma HLS UNROLL
+            if (k != centre) {
+                acc_t res = a00 - taps[k];
+                b_val += res * res;
+            }
+        }
+        return b_val;
+    }
+};
+
+typedef sum_sq_diff<active_points> active_combiner;
 
-    for (int i = 0; i < T_ITERATIONS; i++) {
+// True when every tap stream has a word (performance counters only)
+template <int N>
+bool taps_ready(hls::stream<data_vec_t> taps[N]) {
+    #pragma HLS INLINE
+    bool ready = true;
+    for (int k = 0; k < N; k++) {
+        #pragma HLS UNROLL
+        ready = ready && !taps[k].empty();
+    }
+    return ready;
+}
+
+// True when every tap stream has room for a word (performance counters only)
+template <int N>
+bool taps_space(hls::stream<data_vec_t> taps[N]) {
+    #pragma HLS INLINE
+    bool space = true;
+    for (int k = 0; k < N; k++) {
+        #pragma HLS UNROLL
+        space = space && !taps[k].full();
+    }
+    return space;
+}
+
+// taps[k] carries A[i+di(k)][j+dj(k)] for every output B[i][j], in output order.
+// The taps are widened to acc_t here and the result narrowed back to data_t.
+template <class Points, class Combiner>
+void compute_kernel(hls::stream<data_vec_t> taps[Points::size],
+                    hls::stream<data_vec_t>& out_B,
+                    int rows, int columns, perf_stream_t& perf) {
+
+    const int N = Points::size;
+    Combiner combine;
+    int kernel_words = words_for((rows - HALO_ROWS) * (columns - HALO_COLUMNS));
+    perf_count_t stall = 0;
+    for (int i = 0; i < kernel_words; ) {
         #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_KERNEL_WORDS
+        if (PERF_STALLED(taps_ready<N>(taps) && !out_B.full(), stall)) continue;
 
         // Reading the needed inputs
-        data_t a10 = in_1.read(); //+1 0
-        data_t a01 = in_2.read(); //0 +1
-        data_t a00 = in_3.read(); //0 0
-        data_t a0m1 = in_4.read(); //0 -1
-        data_t am10 = in_5.read(); //-1 0
-
-        // Calculations in Listing 1 (408), Listing 2 (409)
-        data_t res_0 = a00 - a0m1;
-        data_t res_1 = a00 - a01;
-        data_t res_2 = a00 - am10;
-        data_t res_3 = a00 - a10;
+        data_vec_t tap_vec[N];
+        for (int k = 0; k < N; k++) {
+            #pragma HLS UNROLL
+            tap_vec[k] = taps[k].read();
+        }
 
-        data_t b_val = (res_0 * res_0) + (res_1 * res_1) +
-                       (res_2 * res_2) + (res_3 * res_3);
+        data_vec_t b_vec;
+        for (int l = 0; l < P; l++) {
+            #pragma HLS UNROLL
+            acc_t lane_taps[N];
+            for (int k = 0; k < N; k++) {
+                #pragma HLS UNROLL
+                lane_taps[k] = active_format::widen(tap_vec[k].lane[l]);
+            }
+            b_vec.lane[l] = active_format::narrow(combine(lane_taps));
+        }
 
-        out_B.write(b_val);
+        out_B.write(b_vec);
+        i++;
     }
+    perf_report(perf, kernel_words, stall);
 }
 
-template <int T_TOTAL_ELEMENTS>
-void last_splitter_emptying(hls::stream<data_t>& in) { 
-    for (int i = 0; i < T_TOTAL_ELEMENTS; i++) {
+void last_splitter_emptying(hls::stream<data_vec_t>& in, int rows, int columns,
+                            perf_stream_t& perf) {
+    int total_words = words_for(rows * columns);
+    perf_count_t stall = 0;
+    for (int i = 0; i < total_words; ) {
         #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+        if (PERF_STALLED(!in.empty(), stall)) continue;
         in.read();
+        i++;
+    }
+    perf_report(perf, total_words, stall);
+}
+
+// --- STENCIL GENERATOR ---
+// The chain of Figure 5 (411) is built by stencil_chain.h. In 2D the linear
+// offset of a point is di*columns+dj, sized for MAX_COLUMNS, the FIFOs hold
+// P-pixel words, and every filter keeps the domain
+// D_Ax = {(i+di, j+dj) : B[i][j] defined}.
+struct grid_chain {
+    typedef data_vec_t element_t;
+    static const int ELEMENT_PIXELS = P;
+    static const int ELEMENT_BITS = DATA_WIDTH * P;
+
+    template <class Points> static constexpr int linear_offset(int k) {
+        return Points::di(k) * MAX_COLUMNS + Points::dj(k);
+    }
+
+    // Splitter and filter of one stage
+    template <class Points, int STAGE>
+    static void tap(hls::stream<data_vec_t>& in,
+                    hls::stream<data_vec_t>& out_to_next,
+                    hls::stream<data_vec_t> taps[Points::size],
+                    int rows, int columns, perf_stream_t perf[PERF_STEP_PROCESSES]) {
+        #pragma HLS INLINE
+        const int K = stencil_point_at_stage<grid_chain, Points>(STAGE);
+
+        hls::stream<data_vec_t, 4> s_to_f(stencil_stage_names<STAGE>::s_to_f);
+        #pragma HLS STREAM variable=s_to_f depth=4
+
+        DATAFLOW_REGION;
+        DATAFLOW_PROCESS(data_splitter(in, out_to_next, s_to_f, rows, columns, perf[2 * STAGE]));
+        DATAFLOW_PROCESS(data_filter<HALO_TOP + Points::di(K), HALO_BOTTOM - Points::di(K),
+                                     HALO_LEFT + Points::dj(K), HALO_RIGHT - Points::dj(K)>(
+                             s_to_f, taps[K], rows, columns, perf[2 * STAGE + 1]));
+    }
+
+    static void discard(hls::stream<data_vec_t>& in, int rows, int columns,
+                        perf_stream_t perf[PERF_STEP_PROCESSES]) {
+        #pragma HLS INLINE
+        last_splitter_emptying(in, rows, columns, perf[PERF_LAST_SPLITTER]);
+    }
+};
+
+template <class Points, class Combiner>
+void stencil_network(hls::stream<data_vec_t>& A_in,
+                     hls::stream<data_vec_t>& B_out,
+                     int rows, int columns, perf_stream_t perf[PERF_STEP_PROCESSES]) {
+    #pragma HLS INLINE
+    static_assert(stencil_points_distinct<grid_chain, Points>(), "stencil offsets must be distinct");
+
+    hls::stream<data_vec_t, 4> taps[Points::size];
+    #pragma HLS STREAM variable=taps depth=4
+    NAME_STREAMS(taps, "tap");
+
+    DATAFLOW_REGION;
+    DATAFLOW_PROCESS(stencil_stage<grid_chain, Points, 0>::run(A_in, taps, rows, columns, perf));
+    DATAFLOW_PROCESS(compute_kernel<Points, Combiner>(taps, B_out, rows, columns, perf[PERF_COMPUTE]));
+}
+
+// --- LINE-BUFFER ENGINE ---
+// Replaces the splitters, filters and last_splitter_emptying with one process.
+// Two row line buffers hold rows r-2 and r-1, and a 3x3 register window slides
+// along them; once the window is inside the grid the stencil points go straight
+// to compute_kernel. Outputs come out in the same order as the chain. The
+// stencil has to fit the 3x3 window with a halo of one on every side.
+template <class Points>
+void line_buffer_stencil(hls::stream<data_vec_t>& in,
+                         hls::stream<data_vec_t> taps[Points::size],
+                         int rows, int columns, perf_stream_t perf[PERF_STEP_PROCESSES]) {
+    static_assert(stencil_halo_top<Points>() == 1 && stencil_halo_bottom<Points>() == 1 &&
+                  stencil_halo_left<Points>() == 1 && stencil_halo_right<Points>() == 1,
+                  "the line-buffer engine needs a stencil inside a 3x3 window");
+
+    data_t line_buf_0[MAX_COLUMNS]; // row r-2
+    data_t line_buf_1[MAX_COLUMNS]; // row r-1
+    #pragma HLS BIND_STORAGE variable=line_buf_0 type=ram_2p impl=bram
+    #pragma HLS BIND_STORAGE variable=line_buf_1 type=ram_2p impl=bram
+
+    // window[k][m] = A[r-2+k][c-2+m]
+    data_t window[3][3];
+    #pragma HLS ARRAY_PARTITION variable=window complete dim=0
+
+    int total_elements = rows * columns;
+    int r = 0;
+    int c = 0;
+    perf_count_t stall = 0;
+
+    for (int n = 0; n < total_elements; ) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_ELEMENTS
+        #pragma HLS DEPENDENCE variable=line_buf_0 inter false
+        #pragma HLS DEPENDENCE variable=line_buf_1 inter false
+        if (PERF_STALLED(!in.empty() && taps_space<Points::size>(taps), stall)) continue;
+        data_t pixel = in.read().lane[0];
+
+        data_t top = line_buf_0[c];
+        data_t middle = line_buf_1[c];
+        line_buf_0[c] = middle;
+        line_buf_1[c] = pixel;
+
+        for (int k = 0; k < 3; k++) {
+            #pragma HLS UNROLL
+            window[k][0] = window[k][1];
+            window[k][1] = window[k][2];
+        }
+        window[0][2] = top;
+        window[1][2] = middle;
+        window[2][2] = pixel;
+
+        // The window is centred on (r-1, c-1), an interior point
+        if (r >= 2 && c >= 2) {
+            for (int k = 0; k < Points::size; k++) {
+                #pragma HLS UNROLL
+                data_vec_t tap;
+                tap.lane[0] = window[1 + Points::di(k)][1 + Points::dj(k)];
+                taps[k].write(tap);
+            }
+        }
+
+        if (c == columns - 1) {
+            c = 0;
+            r++;
+        } else {
+            c++;
+        }
+        n++;
+    }
+
+    perf_report(perf[0], total_elements, stall);
+    for (int p = 1; p < PERF_STEP_PROCESSES; p++) {
+        if (p != PERF_COMPUTE) perf_report(perf[p], 0, 0);
     }
 }
 
 // --- COMPUTE WRAPPER (This was 'architecture_top_level' in Input 1) ---
-void stencil_compute(hls::stream<data_t> &A_in,
-                     hls::stream<data_t> &B_out) {
+void stencil_compute(hls::stream<data_vec_t> &A_in,
+                     hls::stream<data_vec_t> &B_out,
+                     int rows, int columns, perf_stream_t perf[PERF_STEP_PROCESSES]) {
     #pragma HLS DATAFLOW
 
-    // FIFO initialisation
-    hls::stream<data_t> fifo_0;
-    #pragma HLS STREAM variable=fifo_0 depth=FIFO_0_DEPTH
-    #pragma HLS BIND_STORAGE variable=fifo_0 type=fifo impl=bram
-    
-    hls::stream<data_t> fifo_1;
-    #pragma HLS STREAM variable=fifo_1 depth=FIFO_1_DEPTH // Kept 4
-    
-    hls::stream<data_t> fifo_2;
-    #pragma HLS STREAM variable=fifo_2 depth=FIFO_2_DEPTH // Kept 4
-    
-    hls::stream<data_t> fifo_3;
-    #pragma HLS STREAM variable=fifo_3 depth=FIFO_3_DEPTH
-    #pragma HLS BIND_STORAGE variable=fifo_3 type=fifo impl=bram
-
-    // Intermediate results - Stream depths preserved from Input 1
-    hls::stream<data_t> s0_to_f0, s1_to_f1, s2_to_f2, s3_to_f3, s4_to_f4;
-    hls::stream<data_t> f0_to_compute, f1_to_compute, f2_to_compute, f3_to_compute, f4_to_compute;
-    hls::stream<data_t> to_discard; 
-
-    #pragma HLS STREAM variable=s0_to_f0 depth=4
-    #pragma HLS STREAM variable=s1_to_f1 depth=4
-    #pragma HLS STREAM variable=s2_to_f2 depth=4
-    #pragma HLS STREAM variable=s3_to_f3 depth=4
-    #pragma HLS STREAM variable=s4_to_f4 depth=4
-    #pragma HLS STREAM variable=to_discard depth=4
-    
-    #pragma HLS STREAM variable=f0_to_compute depth=4   
-    #pragma HLS STREAM variable=f1_to_compute depth=4
-    #pragma HLS STREAM variable=f2_to_compute depth=4
-    #pragma HLS STREAM variable=f3_to_compute depth=4 
-    #pragma HLS STREAM variable=f4_to_compute depth=4 
-
-    // All modules initialisation (Acc to Figure 5 (411))
-    // s0 and filter_0 (A[i+1][j]: i=2..767, j=1..1022)
-    data_splitter<TOTAL_ELEMENTS>(A_in, fifo_0, s0_to_f0);
-    data_filter<ROWS, COLUMNS, 2, ROWS-1, 1, COLUMNS-2>(s0_to_f0, f0_to_compute);
-
-    // s1 and filter_1 (A[i][j+1]: i=1..766, j=2..1023)
-    data_splitter<TOTAL_ELEMENTS>(fifo_0, fifo_1, s1_to_f1);
-    data_filter<ROWS, COLUMNS, 1, ROWS-2, 2, COLUMNS-1>(s1_to_f1, f1_to_compute);
-
-    // s2 and filter_2 (A[i][j]: i=1..766, j=1..1022)
-    data_splitter<TOTAL_ELEMENTS>(fifo_1, fifo_2, s2_to_f2);
-    data_filter<ROWS, COLUMNS, 1, ROWS-2, 1, COLUMNS-2>(s2_to_f2, f2_to_compute);
-
-    // s3 and filter_3 (A[i][j-1]: i=1..766, j=0..1021)
-    data_splitter<TOTAL_ELEMENTS>(fifo_2, fifo_3, s3_to_f3);
-    data_filter<ROWS, COLUMNS, 1, ROWS-2, 0, COLUMNS-3>(s3_to_f3, f3_to_compute);
-
-    // s4 and filter_4 (A[i-1][j]: i=0..765, j=1..1022)
-    data_splitter<TOTAL_ELEMENTS>(fifo_3, to_discard, s4_to_f4);
-    data_filter<ROWS, COLUMNS, 0, ROWS-3, 1, COLUMNS-2>(s4_to_f4, f4_to_compute);
-
-    last_splitter_emptying<TOTAL_ELEMENTS>(to_discard);
-
-    // Computation Kernel
-    compute_kernel<KERNEL_ITERATIONS>(
-        f0_to_compute, f1_to_compute, f2_to_compute, f3_to_compute, f4_to_compute, B_out);
+#if STENCIL_ENGINE == STENCIL_ENGINE_LINE_BUFFER
+    hls::stream<data_vec_t, 4> taps[active_points::size];
+    #pragma HLS STREAM variable=taps depth=4
+    NAME_STREAMS(taps, "tap");
+
+    DATAFLOW_REGION;
+    DATAFLOW_PROCESS(line_buffer_stencil<active_points>(A_in, taps, rows, columns, perf));
+    DATAFLOW_PROCESS(compute_kernel<active_points, active_combiner>(taps, B_out, rows, columns, perf[PERF_COMPUTE]));
+#else
+    // All modules generated from active_points (Acc to Figure 5 (411))
+    stencil_network<active_points, active_combiner>(A_in, B_out, rows, columns, perf);
+#endif
+}
+
+// --- TEMPORAL BLOCKING ---
+// Time step STEP runs stencil_compute on the grid produced by step STEP-1, which
+// is STEP halos smaller than A. The steps are chained through streams in the
+// caller's DATAFLOW region, so T steps cost a single pass over DRAM.
+template <int STEP>
+void stencil_time_step(hls::stream<data_vec_t>& in,
+                       hls::stream<data_vec_t>& out,
+                       int rows, int columns, perf_stream_t perf[PERF_STEP_PROCESSES]) {
+    stencil_compute(in, out, rows - STEP * HALO_ROWS, columns - STEP * HALO_COLUMNS, perf);
+}
+
+// Steps STEP..STEP+REMAINING-1 of the cascade
+template <int STEP, int REMAINING>
+struct stencil_cascade {
+    static void run(hls::stream<data_vec_t>& in, hls::stream<data_vec_t>& out,
+                    int rows, int columns, perf_stream_t perf[][PERF_STEP_PROCESSES]) {
+        #pragma HLS INLINE
+        hls::stream<data_vec_t, 4> step_out("step_out");
+        #pragma HLS STREAM variable=step_out depth=4
+
+        DATAFLOW_REGION;
+        DATAFLOW_PROCESS(stencil_time_step<STEP>(in, step_out, rows, columns, perf[STEP]));
+        DATAFLOW_PROCESS(stencil_cascade<STEP + 1, REMAINING - 1>::run(step_out, out, rows, columns, perf));
+    }
+};
+
+template <int STEP>
+struct stencil_cascade<STEP, 1> {
+    static void run(hls::stream<data_vec_t>& in, hls::stream<data_vec_t>& out,
+                    int rows, int columns, perf_stream_t perf[][PERF_STEP_PROCESSES]) {
+        #pragma HLS INLINE
+        stencil_time_step<STEP>(in, out, rows, columns, perf[STEP]);
+    }
+};
+
+// --- PERFORMANCE COUNTER COLLECTION ---
+#if ENABLE_PERF_COUNTERS
+// Counts cycles until store_output is done; load_span is the count at the
+// cycle load_input was done
+void perf_cycle_counter(perf_stream_t& load_done, perf_stream_t& store_done,
+                        perf_stream_t& spans) {
+    perf_count_t cycles = 0;
+    perf_count_t load_span = 0;
+    bool load_finished = false;
+    bool store_finished = false;
+    perf_count_t token;
+    while (!store_finished) {
+        #pragma HLS PIPELINE II=1
+        cycles++;
+        if (!load_finished && load_done.read_nb(token)) {
+            load_finished = true;
+            load_span = cycles;
+        }
+        if (store_done.read_nb(token)) store_finished = true;
+    }
+    spans.write(load_span);
+    spans.write(cycles);
+}
+
+// span - busy - waited, or 0 when the counts overlap
+perf_count_t perf_remainder(perf_count_t span, perf_count_t busy, perf_count_t waited) {
+    return (span > busy + waited) ? perf_count_t(span - busy - waited) : perf_count_t(0);
+}
+
+void perf_collect(perf_stream_t& load_perf, perf_stream_t& store_perf, perf_stream_t& spans,
+                  perf_stream_t step_perf[TIME_STEPS][PERF_STEP_PROCESSES],
+                  perf_count_t perf_counters[NUM_PERF_COUNTERS]) {
+    perf_count_t load_busy = load_perf.read();
+    perf_count_t backpressure = load_perf.read();
+    perf_count_t store_busy = store_perf.read();
+    perf_count_t starved = store_perf.read();
+    perf_count_t load_span = spans.read();
+    perf_count_t total_cycles = spans.read();
+
+    perf_counters[PERF_TOTAL_CYCLES] = total_cycles;
+    perf_counters[PERF_LOAD_BUSY] = load_busy;
+    perf_counters[PERF_LOAD_BACKPRESSURE] = backpressure;
+    perf_counters[PERF_GMEM0_STALL] = perf_remainder(load_span, load_busy, backpressure);
+    perf_counters[PERF_STORE_BUSY] = store_busy;
+    perf_counters[PERF_STORE_STARVED] = starved;
+    perf_counters[PERF_GMEM1_STALL] = perf_remainder(total_cycles, store_busy, starved);
+
+    for (int t = 0; t < TIME_STEPS; t++) {
+        for (int p = 0; p < PERF_STEP_PROCESSES; p++) {
+            #pragma HLS PIPELINE II=2
+            perf_counters[perf_step_counter(t, p)] = step_perf[t][p].read();
+            perf_counters[perf_step_counter(t, p) + 1] = step_perf[t][p].read();
+        }
+    }
+}
+
+// Drains the step counters of the top levels that do not expose them
+template <int STEPS>
+void perf_discard(perf_stream_t step_perf[STEPS][PERF_STEP_PROCESSES]) {
+    for (int t = 0; t < STEPS; t++) {
+        for (int p = 0; p < PERF_STEP_PROCESSES; p++) {
+            #pragma HLS PIPELINE II=2
+            step_perf[t][p].read();
+            step_perf[t][p].read();
+        }
+    }
+}
+#endif
+
+// --- OUTPUT STATISTICS ---
+// With ENABLE_STATS output_tee copies every word of B to output_statistics,
+// which returns in the s_axilite arrays of architecture_top_level:
+//   stats_values[STATS_SUM / STATS_MIN / STATS_MAX]   sum, minimum and maximum of B
+//   stats_counts[STATS_ABOVE_THRESHOLD]                pixels > threshold
+//   stats_counts[STATS_BELOW_RANGE / STATS_ABOVE_RANGE] pixels < histogram_low / >= histogram_high
+//                                                      (NaN pixels count as above the range)
+//   stats_counts[STATS_HISTOGRAM + k]                  pixels in bin k of STATS_BINS
+//                                                      equal bins over [histogram_low, histogram_high)
+// Statistics are taken in float whatever the DATA_FORMAT. The P pixels of a
+// word are summed by an adder tree and the word sums go round-robin into
+// STATS_SUM_LANES partial sums, more than the float adder latency, so the
+// accumulation keeps II=1; the partial sums are added at the end. Every lane
+// has its own histogram, merged at the end as well. A histogram bin is a
+// read-modify-write of BRAM that takes several iterations to land, so each lane
+// keeps its last STATS_RMW_DISTANCE updates (bin and new count) in registers
+// and a bin found there takes its count from the newest match instead of the
+// RAM; any older update is at least STATS_RMW_DISTANCE iterations back and has
+// been written.
+const int STATS_SUM = 0;
+const int STATS_MIN = 1;
+const int STATS_MAX = 2;
+const int NUM_STATS_VALUES = 3;
+
+const int STATS_BINS = 64;
+const int STATS_ABOVE_THRESHOLD = 0;
+const int STATS_BELOW_RANGE = 1;
+const int STATS_ABOVE_RANGE = 2;
+const int STATS_HISTOGRAM = 3;
+const int NUM_STATS_COUNTS = STATS_HISTOGRAM + STATS_BINS;
+
+const int STATS_SUM_LANES = 8;
+const int STATS_RMW_DISTANCE = 4;
+
+typedef ap_uint<32> stats_count_t;
+
+#if ENABLE_STATS
+// Sends B to store_output (when it is written) and to output_statistics
+void output_tee(hls::stream<data_vec_t>& in, hls::stream<data_vec_t>& to_store,
+                hls::stream<data_vec_t>& to_stats,
+                int rows, int columns, int boundary, bool write_output) {
+    int output_words = words_for((grid_rows(rows, boundary) - OUTPUT_HALO_ROWS) *
+                                 (grid_columns(columns, boundary) - OUTPUT_HALO_COLUMNS));
+    for (int i = 0; i < output_words; i++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_OUTPUT_WORDS
+        data_vec_t vec = in.read();
+        if (write_output) to_store.write(vec);
+        to_stats.write(vec);
+    }
+}
+
+void output_statistics(hls::stream<data_vec_t>& in,
+                       int rows, int columns, int boundary,
+                       float threshold, float histogram_low, float histogram_high,
+                       float stats_values[NUM_STATS_VALUES],
+                       stats_count_t stats_counts[NUM_STATS_COUNTS]) {
+    float partial_sum[STATS_SUM_LANES];
+    #pragma HLS ARRAY_PARTITION variable=partial_sum complete
+    stats_count_t histogram[P][STATS_BINS];
+    #pragma HLS ARRAY_PARTITION variable=histogram complete dim=1
+    float lane_min[P];
+    float lane_max[P];
+    stats_count_t above_threshold[P];
+    stats_count_t below_range[P];
+    stats_count_t above_range[P];
+    // Last STATS_RMW_DISTANCE bins each lane updated and their counts, newest first
+    int recent_bin[P][STATS_RMW_DISTANCE];
+    stats_count_t recent_count[P][STATS_RMW_DISTANCE];
+    #pragma HLS ARRAY_PARTITION variable=lane_min complete
+    #pragma HLS ARRAY_PARTITION variable=lane_max complete
+    #pragma HLS ARRAY_PARTITION variable=above_threshold complete
+    #pragma HLS ARRAY_PARTITION variable=below_range complete
+    #pragma HLS ARRAY_PARTITION variable=above_range complete
+    #pragma HLS ARRAY_PARTITION variable=recent_bin complete dim=0
+    #pragma HLS ARRAY_PARTITION variable=recent_count complete dim=0
+
+    for (int k = 0; k < STATS_SUM_LANES; k++) {
+        #pragma HLS UNROLL
+        partial_sum[k] = 0.0f;
+    }
+    for (int b = 0; b < STATS_BINS; b++) {
+        #pragma HLS PIPELINE II=1
+        for (int l = 0; l < P; l++) {
+            histogram[l][b] = 0;
+        }
+    }
+    for (int l = 0; l < P; l++) {
+        #pragma HLS UNROLL
+        lane_min[l] = 3.402823466e+38f;
+        lane_max[l] = -3.402823466e+38f;
+        above_threshold[l] = 0;
+        below_range[l] = 0;
+        above_range[l] = 0;
+        for (int d = 0; d < STATS_RMW_DISTANCE; d++) {
+            recent_bin[l][d] = -1;
+            recent_count[l][d] = 0;
+        }
+    }
+
+    int output_elements = (grid_rows(rows, boundary) - OUTPUT_HALO_ROWS) *
+                          (grid_columns(columns, boundary) - OUTPUT_HALO_COLUMNS);
+    int output_words = words_for(output_elements);
+    float bin_scale = STATS_BINS / (histogram_high - histogram_low);
+
+    for (int i = 0; i < output_words; i++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_OUTPUT_WORDS
+        #pragma HLS DEPENDENCE variable=partial_sum inter distance=STATS_SUM_LANES true
+        #pragma HLS DEPENDENCE variable=histogram inter distance=STATS_RMW_DISTANCE true
+        data_vec_t vec = in.read();
+
+        float word_sum = 0.0f;
+        for (int l = 0; l < P; l++) {
+            #pragma HLS UNROLL
+            // The last word of B may be partial
+            if (i * P + l < output_elements) {
+                float value = active_format::to_float(vec.lane[l]);
+                word_sum += value;
+                if (value < lane_min[l]) lane_min[l] = value;
+                if (value > lane_max[l]) lane_max[l] = value;
+                if (value > threshold) above_threshold[l]++;
+
+                // NaN fails every comparison, so it must not reach the bin index
+                if (value < histogram_low) {
+                    below_range[l]++;
+                } else if (!(value < histogram_high)) {
+                    above_range[l]++;
+                } else {
+                    int bin = (int)((value - histogram_low) * bin_scale);
+                    if (bin < 0) bin = 0;
+                    if (bin > STATS_BINS - 1) bin = STATS_BINS - 1;
+                    stats_count_t count = histogram[l][bin] + 1;
+                    for (int d = STATS_RMW_DISTANCE - 1; d >= 0; d--) {
+                        // Newest match applied last
+                        if (recent_bin[l][d] == bin) count = recent_count[l][d] + 1;
+                    }
+                    histogram[l][bin] = count;
+                    for (int d = STATS_RMW_DISTANCE - 1; d > 0; d--) {
+                        recent_bin[l][d] = recent_bin[l][d - 1];
+                        recent_count[l][d] = recent_count[l][d - 1];
+                    }
+                    recent_bin[l][0] = bin;
+                    recent_count[l][0] = count;
+                }
+            }
+        }
+        partial_sum[i % STATS_SUM_LANES] += word_sum;
+    }
+
+    float sum = 0.0f;
+    for (int k = 0; k < STATS_SUM_LANES; k++) {
+        sum += partial_sum[k];
+    }
+    float minimum = lane_min[0];
+    float maximum = lane_max[0];
+    stats_count_t threshold_count = 0;
+    stats_count_t below_count = 0;
+    stats_count_t above_count = 0;
+    for (int l = 0; l < P; l++) {
+        if (lane_min[l] < minimum) minimum = lane_min[l];
+        if (lane_max[l] > maximum) maximum = lane_max[l];
+        threshold_count += above_threshold[l];
+        below_count += below_range[l];
+        above_count += above_range[l];
+    }
+
+    stats_values[STATS_SUM] = sum;
+    stats_values[STATS_MIN] = minimum;
+    stats_values[STATS_MAX] = maximum;
+    stats_counts[STATS_ABOVE_THRESHOLD] = threshold_count;
+    stats_counts[STATS_BELOW_RANGE] = below_count;
+    stats_counts[STATS_ABOVE_RANGE] = above_count;
+    for (int b = 0; b < STATS_BINS; b++) {
+        #pragma HLS PIPELINE II=1
+        stats_count_t bin_count = 0;
+        for (int l = 0; l < P; l++) {
+            bin_count += histogram[l][b];
+        }
+        stats_counts[STATS_HISTOGRAM + b] = bin_count;
+    }
 }
+#endif
 
 // --- TOP LEVEL ARCHITECTURE ---
-void architecture_top_level(data_t* A_in_mem, data_t* B_out_mem) {
-    
+// rows/columns select the frame size at runtime (see MAX_ROWS/MAX_COLUMNS).
+// Both buffers are row-major grids of DATA_FORMAT pixels moved P pixels per AXI word, so
+// they must be allocated to a whole number of words. A is dense, words_for(rows*columns).
+// B is output_rows x output_columns: (rows-OUTPUT_HALO_ROWS) x (columns-OUTPUT_HALO_COLUMNS)
+// for BOUNDARY_CROP and rows x columns for the other boundary modes (see BOUNDARY MODES).
+// With output_pitch 0 B is dense, words_for(output_rows*output_columns) words; else
+// row r starts at pixel r*output_pitch, which must be a multiple of P and at least
+// output_columns, and B takes (output_rows-1)*output_pitch/P + words_for(output_columns) words.
+// The pixels past the end of the last word of B (of every row, when pitched) are
+// written with don't-care values.
+// The padded modes need columns + OUTPUT_HALO_COLUMNS <= MAX_COLUMNS and, for mirror,
+// rows and columns above the pad, and they load A at one pixel per clock; so does a
+// pitched store. With PARALLEL_FACTOR 1 both still run at full rate.
+// With ENABLE_PERF_COUNTERS the counters of the call are left in perf_counters.
+// With ENABLE_STATS the statistics of B are left in stats_values/stats_counts
+// (see OUTPUT STATISTICS), and B is only written to B_out_mem if write_output is set.
+// With ENABLE_ROW_PROGRESS the number of complete B rows is kept in row_progress
+// while B is written (see ROW PROGRESS).
+void architecture_top_level(mem_word_t* A_in_mem, b_port_t B_out_mem,
+                            int rows, int columns, int boundary, int output_pitch
+#if ENABLE_STATS
+                            , int write_output, float threshold,
+                            float histogram_low, float histogram_high,
+                            float stats_values[NUM_STATS_VALUES],
+                            stats_count_t stats_counts[NUM_STATS_COUNTS]
+#endif
+#if ENABLE_PERF_COUNTERS
+                            , perf_count_t perf_counters[NUM_PERF_COUNTERS]
+#endif
+#if ENABLE_ROW_PROGRESS
+                            , volatile int* row_progress
+#endif
+                            ) {
+
     // Interfaces for Memory
-    #pragma HLS INTERFACE m_axi port=A_in_mem bundle=gmem0 depth=TOTAL_ELEMENTS
-    #pragma HLS INTERFACE m_axi port=B_out_mem bundle=gmem1 depth=KERNEL_ITERATIONS
+    #pragma HLS INTERFACE m_axi port=A_in_mem bundle=gmem0 depth=MAX_TOTAL_WORDS
+    #pragma HLS INTERFACE m_axi port=B_out_mem bundle=gmem1 depth=MAX_OUTPUT_WORDS
+    #pragma HLS INTERFACE s_axilite port=rows
+    #pragma HLS INTERFACE s_axilite port=columns
+    #pragma HLS INTERFACE s_axilite port=boundary
+    #pragma HLS INTERFACE s_axilite port=output_pitch
+#if ENABLE_STATS
+    #pragma HLS INTERFACE s_axilite port=write_output
+    #pragma HLS INTERFACE s_axilite port=threshold
+    #pragma HLS INTERFACE s_axilite port=histogram_low
+    #pragma HLS INTERFACE s_axilite port=histogram_high
+    #pragma HLS INTERFACE s_axilite port=stats_values
+    #pragma HLS INTERFACE s_axilite port=stats_counts
+#endif
+#if ENABLE_PERF_COUNTERS
+    #pragma HLS INTERFACE s_axilite port=perf_counters
+#endif
+#if ENABLE_ROW_PROGRESS
+    #pragma HLS INTERFACE m_axi port=row_progress bundle=gmem1 depth=1
+#endif
+    #pragma HLS INTERFACE s_axilite port=return
+
+    #pragma HLS DATAFLOW
+    TOP_LEVEL_REGION;
+
+    hls::stream<data_vec_t, 128> input_stream("input_stream");
+    #pragma HLS STREAM variable=input_stream depth=128
+
+    hls::stream<data_vec_t, 128> output_stream("output_stream");
+    #pragma HLS STREAM variable=output_stream depth=128
+
+    perf_stream_t step_perf[TIME_STEPS][PERF_STEP_PROCESSES];
+    perf_stream_t store_done;
+#if ENABLE_PERF_COUNTERS
+    perf_stream_t load_perf;
+    perf_stream_t store_perf;
+    perf_stream_t load_done;
+    perf_stream_t spans;
+
+    // load_input -> perf_load_probe -> input_stream, network -> perf_store_probe -> output_stream
+    hls::stream<data_vec_t, 4> load_stream("load_stream");
+    #pragma HLS STREAM variable=load_stream depth=4
+
+    hls::stream<data_vec_t, 4> network_stream("network_stream");
+    #pragma HLS STREAM variable=network_stream depth=4
+#endif
+#if ENABLE_STATS
+    hls::stream<data_vec_t, 4> store_stream("store_stream");
+    #pragma HLS STREAM variable=store_stream depth=4
+
+    hls::stream<data_vec_t, 4> stats_stream("stats_stream");
+    #pragma HLS STREAM variable=stats_stream depth=4
+#endif
+
+    int network_rows = grid_rows(rows, boundary);
+    int network_columns = grid_columns(columns, boundary);
+
+    DATAFLOW_REGION;
+#if ENABLE_PERF_COUNTERS
+    DATAFLOW_PROCESS(load_input(A_in_mem, load_stream, rows, columns, boundary));
+    DATAFLOW_PROCESS(perf_load_probe(load_stream, input_stream,
+                                     words_for(network_rows * network_columns), load_perf, load_done));
+    DATAFLOW_PROCESS(stencil_cascade<0, TIME_STEPS>::run(input_stream, network_stream,
+                                                         network_rows, network_columns, step_perf));
+    DATAFLOW_PROCESS(perf_store_probe(network_stream, output_stream,
+                                      words_for((network_rows - OUTPUT_HALO_ROWS) *
+                                                (network_columns - OUTPUT_HALO_COLUMNS)),
+                                      store_perf));
+#else
+    DATAFLOW_PROCESS(load_input(A_in_mem, input_stream, rows, columns, boundary));
+    DATAFLOW_PROCESS(stencil_cascade<0, TIME_STEPS>::run(input_stream, output_stream,
+                                                         network_rows, network_columns, step_perf));
+#endif
+#if ENABLE_STATS
+    DATAFLOW_PROCESS(output_tee(output_stream, store_stream, stats_stream,
+                                rows, columns, boundary, write_output));
+    DATAFLOW_PROCESS(output_statistics(stats_stream, rows, columns, boundary,
+                                       threshold, histogram_low, histogram_high,
+                                       stats_values, stats_counts));
+    DATAFLOW_PROCESS(store_output(store_stream, B_out_mem, rows, columns, boundary, output_pitch,
+                                  write_output, store_done
+#if ENABLE_ROW_PROGRESS
+                                  , row_progress
+#endif
+                                  ));
+#else
+    DATAFLOW_PROCESS(store_output(output_stream, B_out_mem, rows, columns, boundary, output_pitch,
+                                  true, store_done
+#if ENABLE_ROW_PROGRESS
+                                  , row_progress
+#endif
+                                  ));
+#endif
+#if ENABLE_PERF_COUNTERS
+    DATAFLOW_PROCESS(perf_cycle_counter(load_done, store_done, spans));
+    DATAFLOW_PROCESS(perf_collect(load_perf, store_perf, spans, step_perf, perf_counters));
+#endif
+}
+// --- COLUMN STRIPS (MULTI COMPUTE UNIT) ---
+// architecture_top_level_strips splits the grid into up to STRIP_UNITS vertical
+// strips and runs each one through its own stencil_compute cascade with its own
+// pair of m_axi bundles (strip s reads on gmem<2s> and writes on gmem<2s+1>).
+// Neighbouring strips overlap by OUTPUT_HALO_COLUMNS = TIME_STEPS * HALO_COLUMNS
+// input columns (the stencil's left plus right halo for every time step: two for
+// one 5-point step), so every strip produces a disjoint range of B columns and B
+// keeps the exact layout of architecture_top_level. A strip only has to fit MAX_COLUMNS, so the grid can be
+// up to MAX_STRIP_GRID_COLUMNS wide.
+// The host passes the same A buffer to every A_in_mem_s and the same B buffer to
+// every B_out_mem_s; 'strips' (1..STRIP_UNITS) selects how many units take part.
+// Strips start at arbitrary pixel columns, so this top level needs PARALLEL_FACTOR 1.
+const int STRIP_UNITS = 4;
+const int MAX_STRIP_GRID_COLUMNS = STRIP_UNITS * (MAX_COLUMNS - OUTPUT_HALO_COLUMNS) + OUTPUT_HALO_COLUMNS;
+const int MAX_STRIP_TOTAL_ELEMENTS = MAX_ROWS * MAX_STRIP_GRID_COLUMNS;
+const int MAX_STRIP_OUTPUT_ELEMENTS = (MAX_ROWS - OUTPUT_HALO_ROWS) * (MAX_STRIP_GRID_COLUMNS - OUTPUT_HALO_COLUMNS);
+
+#if PARALLEL_FACTOR == 1
+// Reads columns col_begin..col_begin+strip_columns-1 of every row of A. One loop
+// per row, so that its address is affine in the loop counter and the strip row
+// becomes one gmem burst.
+void load_strip(mem_word_t* in_mem, hls::stream<data_vec_t>& in_stream,
+                int rows, int columns, int col_begin, int strip_columns) {
+    for (int r = 0; r < rows; r++) {
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_ROWS
+        int row_first = r * columns + col_begin;
+        for (int c = 0; c < strip_columns; c++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT max=MAX_COLUMNS
+            data_vec_t temp;
+            temp.lane[0] = bits_to_data(in_mem[row_first + c]);
+            in_stream.write(temp);
+        }
+    }
+}
+
+// Writes the strip's outputs into B columns out_begin..out_begin+out_columns-1,
+// one burst per row as in load_strip
+void store_strip(hls::stream<data_vec_t>& out_stream, mem_word_t* out_mem,
+                 int rows, int columns, int out_begin, int out_columns) {
+    int output_rows = rows - OUTPUT_HALO_ROWS;
+    int output_pitch = columns - OUTPUT_HALO_COLUMNS;
+    for (int r = 0; r < output_rows; r++) {
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_ROWS
+        int row_first = r * output_pitch + out_begin;
+        for (int c = 0; c < out_columns; c++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT max=MAX_COLUMNS
+            out_mem[row_first + c] = data_to_bits(out_stream.read().lane[0]);
+        }
+    }
+}
+
+void stencil_strip_dataflow(mem_word_t* A_in_mem, mem_word_t* B_out_mem,
+                            int rows, int columns, int out_begin, int out_columns) {
+    #pragma HLS DATAFLOW
+
+    hls::stream<data_vec_t, 128> input_stream("input_stream");
+    #pragma HLS STREAM variable=input_stream depth=128
+
+    hls::stream<data_vec_t, 128> output_stream("output_stream");
+    #pragma HLS STREAM variable=output_stream depth=128
+
+    perf_stream_t step_perf[TIME_STEPS][PERF_STEP_PROCESSES];
+
+    int strip_columns = out_columns + OUTPUT_HALO_COLUMNS;
+
+    DATAFLOW_REGION;
+    DATAFLOW_PROCESS(load_strip(A_in_mem, input_stream, rows, columns, out_begin, strip_columns));
+    DATAFLOW_PROCESS(stencil_cascade<0, TIME_STEPS>::run(input_stream, output_stream, rows, strip_columns, step_perf));
+    DATAFLOW_PROCESS(store_strip(output_stream, B_out_mem, rows, columns, out_begin, out_columns));
+#if ENABLE_PERF_COUNTERS
+    DATAFLOW_PROCESS(perf_discard<TIME_STEPS>(step_perf));
+#endif
+}
+
+// Compute unit 'strip': B columns out_begin..out_end-1, from A columns
+// out_begin..out_end-1+OUTPUT_HALO_COLUMNS
+void stencil_strip(mem_word_t* A_in_mem, mem_word_t* B_out_mem,
+                   int rows, int columns, int strips, int strip) {
+    if (strip >= strips) return;
+
+    int output_columns = columns - OUTPUT_HALO_COLUMNS;
+    int out_begin = output_columns * strip / strips;
+    int out_end = output_columns * (strip + 1) / strips;
+    if (out_end == out_begin) return;
+
+    stencil_strip_dataflow(A_in_mem, B_out_mem, rows, columns, out_begin, out_end - out_begin);
+}
+
+// Valid runtime sizes: as architecture_top_level, but columns up to
+// MAX_STRIP_GRID_COLUMNS as long as every strip fits MAX_COLUMNS:
+// ceil((columns-OUTPUT_HALO_COLUMNS)/strips) + OUTPUT_HALO_COLUMNS <= MAX_COLUMNS.
+void architecture_top_level_strips(mem_word_t* A_in_mem_0, mem_word_t* A_in_mem_1,
+                                   mem_word_t* A_in_mem_2, mem_word_t* A_in_mem_3,
+                                   mem_word_t* B_out_mem_0, mem_word_t* B_out_mem_1,
+                                   mem_word_t* B_out_mem_2, mem_word_t* B_out_mem_3,
+                                   int rows, int columns, int strips) {
+
+    // One read and one write bundle per compute unit
+    #pragma HLS INTERFACE m_axi port=A_in_mem_0 bundle=gmem0 depth=MAX_STRIP_TOTAL_ELEMENTS
+    #pragma HLS INTERFACE m_axi port=B_out_mem_0 bundle=gmem1 depth=MAX_STRIP_OUTPUT_ELEMENTS
+    #pragma HLS INTERFACE m_axi port=A_in_mem_1 bundle=gmem2 depth=MAX_STRIP_TOTAL_ELEMENTS
+    #pragma HLS INTERFACE m_axi port=B_out_mem_1 bundle=gmem3 depth=MAX_STRIP_OUTPUT_ELEMENTS
+    #pragma HLS INTERFACE m_axi port=A_in_mem_2 bundle=gmem4 depth=MAX_STRIP_TOTAL_ELEMENTS
+    #pragma HLS INTERFACE m_axi port=B_out_mem_2 bundle=gmem5 depth=MAX_STRIP_OUTPUT_ELEMENTS
+    #pragma HLS INTERFACE m_axi port=A_in_mem_3 bundle=gmem6 depth=MAX_STRIP_TOTAL_ELEMENTS
+    #pragma HLS INTERFACE m_axi port=B_out_mem_3 bundle=gmem7 depth=MAX_STRIP_OUTPUT_ELEMENTS
+    #pragma HLS INTERFACE s_axilite port=rows
+    #pragma HLS INTERFACE s_axilite port=columns
+    #pragma HLS INTERFACE s_axilite port=strips
     #pragma HLS INTERFACE s_axilite port=return
 
     #pragma HLS DATAFLOW
+    TOP_LEVEL_REGION;
+
+    DATAFLOW_REGION;
+    DATAFLOW_PROCESS(stencil_strip(A_in_mem_0, B_out_mem_0, rows, columns, strips, 0));
+    DATAFLOW_PROCESS(stencil_strip(A_in_mem_1, B_out_mem_1, rows, columns, strips, 1));
+    DATAFLOW_PROCESS(stencil_strip(A_in_mem_2, B_out_mem_2, rows, columns, strips, 2));
+    DATAFLOW_PROCESS(stencil_strip(A_in_mem_3, B_out_mem_3, rows, columns, strips, 3));
+}
+#endif
+
+// --- FREE-RUNNING AXI4-STREAM TOP LEVEL ---
+// architecture_top_level_axis takes A and returns B as AXI4-Stream frames of
+// P-pixel words in the same packing as gmem0/gmem1:
+//   TUSER = 1 on the first word of a frame (start of frame)
+//   TLAST = 1 on the last word of a frame
+//   TKEEP/TSTRB mark the valid pixels of the last, partially filled B word
+// It has no start/done handshake (ap_ctrl_none): every DATAFLOW process restarts
+// as soon as it finishes its frame, so the head of frame f+1 streams into the
+// network while the tail of frame f is still draining. One C call processes one
+// frame. rows/columns are s_axilite registers that must stay constant while frames flow.
+//
+// The loader resynchronises on TUSER: words before a start of frame are dropped,
+// a frame that ends early (TLAST or a new TUSER) is padded with zeros, and a frame
+// that is too long is cut at the expected size with the rest dropped up to its TLAST.
+typedef ap_axiu<DATA_WIDTH * PARALLEL_FACTOR, 1, 1, 1> axis_word_t;
+
+const int AXIS_BYTES_PER_PIXEL = DATA_WIDTH / 8;
+
+void axis_load_frame(hls::stream<axis_word_t>& A_in, hls::stream<data_vec_t>& in_stream,
+                     int rows, int columns) {
+    // Start of the next frame, when it arrived before the current frame had ended
+    static bool sof_pending = false;
+    static axis_word_t sof_word;
 
-    hls::stream<data_t> input_stream;
-    #pragma HLS STREAM variable=input_stream depth=128 
-    
-    hls::stream<data_t> output_stream;
-    #pragma HLS STREAM variable=output_stream depth=128 
+    axis_word_t word;
+    if (sof_pending) {
+        word = sof_word;
+        sof_pending = false;
+    } else {
+        do {
+            #pragma HLS PIPELINE II=1
+            word = A_in.read();
+        } while (!word.user);
+    }
 
-    load_input(A_in_mem, input_stream);
-    stencil_compute(input_stream, output_stream);
-    store_output(output_stream, B_out_mem);
-}
\ No newline at end of file
+    int total_words = words_for(rows * columns);
+    bool ended = false;
+    for (int n = 0; n < total_words; n++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+        if (n > 0 && !ended) {
+            word = A_in.read();
+            if (word.user) {
+                sof_word = word;
+                sof_pending = true;
+                ended = true;
+            }
+        }
+
+        data_vec_t temp = unpack_word(word.data);
+        if (ended) {
+            for (int l = 0; l < P; l++) {
+                #pragma HLS UNROLL
+                temp.lane[l] = 0;
+            }
+        }
+        in_stream.write(temp);
+
+        if (word.last) ended = true;
+    }
+
+    // Frame longer than rows x columns: drop the excess
+    while (!ended) {
+        #pragma HLS PIPELINE II=1
+        word = A_in.read();
+        if (word.user) {
+            sof_word = word;
+            sof_pending = true;
+            ended = true;
+        } else if (word.last) {
+            ended = true;
+        }
+    }
+}
+
+void axis_store_frame(hls::stream<data_vec_t>& out_stream, hls::stream<axis_word_t>& B_out,
+                      int rows, int columns) {
+    int output_elements = (rows - OUTPUT_HALO_ROWS) * (columns - OUTPUT_HALO_COLUMNS);
+    int output_words = words_for(output_elements);
+    int last_lanes = output_elements - (output_words - 1) * P;
+
+    for (int i = 0; i < output_words; i++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_OUTPUT_WORDS
+        bool last = (i == output_words - 1);
+        int lanes = last ? last_lanes : P;
+
+        axis_word_t word;
+        word.data = pack_word(out_stream.read());
+        word.keep = 0;
+        for (int l = 0; l < P; l++) {
+            #pragma HLS UNROLL
+            if (l < lanes) {
+                word.keep.range(AXIS_BYTES_PER_PIXEL * l + AXIS_BYTES_PER_PIXEL - 1,
+                                AXIS_BYTES_PER_PIXEL * l) = (1 << AXIS_BYTES_PER_PIXEL) - 1;
+            }
+        }
+        word.strb = word.keep;
+        word.user = (i == 0);
+        word.last = last;
+        word.id = 0;
+        word.dest = 0;
+        B_out.write(word);
+    }
+}
+
+void architecture_top_level_axis(hls::stream<axis_word_t>& A_in, hls::stream<axis_word_t>& B_out,
+                                 int rows, int columns) {
+
+    #pragma HLS INTERFACE axis port=A_in
+    #pragma HLS INTERFACE axis port=B_out
+    #pragma HLS INTERFACE s_axilite port=rows
+    #pragma HLS INTERFACE s_axilite port=columns
+    #pragma HLS INTERFACE ap_ctrl_none port=return
+
+    #pragma HLS DATAFLOW
+    TOP_LEVEL_REGION;
+
+    hls::stream<data_vec_t, 128> input_stream("input_stream");
+    #pragma HLS STREAM variable=input_stream depth=128
+
+    hls::stream<data_vec_t, 128> output_stream("output_stream");
+    #pragma HLS STREAM variable=output_stream depth=128
+
+    perf_stream_t step_perf[TIME_STEPS][PERF_STEP_PROCESSES];
+
+    DATAFLOW_REGION;
+    DATAFLOW_PROCESS(axis_load_frame(A_in, input_stream, rows, columns));
+    DATAFLOW_PROCESS(stencil_cascade<0, TIME_STEPS>::run(input_stream, output_stream, rows, columns, step_perf));
+    DATAFLOW_PROCESS(axis_store_frame(output_stream, B_out, rows, columns));
+#if ENABLE_PERF_COUNTERS
+    DATAFLOW_PROCESS(perf_discard<TIME_STEPS>(step_perf));
+#endif
+}
+
+// --- GRADIENT TOP LEVEL ---
+// architecture_top_level_gradient runs one stencil step on A and returns, from the
+// same taps and the same single read of A, every field selected by GRADIENT_OUTPUTS:
+//   GRADIENT_SUM_SQ     sum of the squared differences (what architecture_top_level returns)
+//   GRADIENT_DX         (A[i][j+1] - A[i][j-1]) / 2
+//   GRADIENT_DY         (A[i+1][j] - A[i-1][j]) / 2
+//   GRADIENT_MAGNITUDE  sqrt(dx^2 + dy^2)
+//   GRADIENT_DIRECTION  atan2(dy, dx) rounded to one of 8 sectors of 45 degrees,
+//                       0 = +x (right), 2 = +y (down), ..., 7; stored as a pixel value
+// Every field is a (rows-HALO_ROWS) x (columns-HALO_COLUMNS) grid in the layout of B,
+// written on its own m_axi bundle (structure of arrays, gmem1..gmem5). The buffers
+// of unselected fields are not touched. Needs a stencil with A[i][j±1] and
+// A[i±1][j] (STENCIL_SHAPE 5, 9 or 13); TIME_STEPS and the boundary modes do not apply.
+#define GRADIENT_SUM_SQ 1
+#define GRADIENT_DX 2
+#define GRADIENT_DY 4
+#define GRADIENT_MAGNITUDE 8
+#define GRADIENT_DIRECTION 16
+
+// Fields built into architecture_top_level_gradient. Set with -DGRADIENT_OUTPUTS=mask.
+#ifndef GRADIENT_OUTPUTS
+#define GRADIENT_OUTPUTS (GRADIENT_SUM_SQ | GRADIENT_DX | GRADIENT_DY | GRADIENT_MAGNITUDE | GRADIENT_DIRECTION)
+#endif
+
+#if STENCIL_SHAPE != 6
+// Stream index of each field
+const int FIELD_SUM_SQ = 0;
+const int FIELD_DX = 1;
+const int FIELD_DY = 2;
+const int FIELD_MAGNITUDE = 3;
+const int FIELD_DIRECTION = 4;
+const int NUM_GRADIENT_FIELDS = 5;
+
+// 8-sector direction of (dx, dy) without trigonometry: tan(22.5) and tan(67.5)
+// separate the horizontal, diagonal and vertical sectors
+int gradient_direction(acc_t dx, acc_t dy) {
+    #pragma HLS INLINE
+    const acc_t zero = 0;
+    acc_t ax = (dx < zero) ? acc_t(-dx) : dx;
+    acc_t ay = (dy < zero) ? acc_t(-dy) : dy;
+    if (ay <= ax * acc_t(0.41421356f)) return (dx >= zero) ? 0 : 4;
+    if (ay >= ax * acc_t(2.41421356f)) return (dy >= zero) ? 2 : 6;
+    if (dx >= zero) return (dy >= zero) ? 1 : 7;
+    return (dy >= zero) ? 3 : 5;
+}
+
+template <class Points>
+void gradient_kernel(hls::stream<data_vec_t> taps[Points::size],
+                     hls::stream<data_vec_t> fields[NUM_GRADIENT_FIELDS],
+                     int rows, int columns, perf_stream_t& perf) {
+    const int N = Points::size;
+    const int LEFT = stencil_point_index<Points>(0, -1);
+    const int RIGHT = stencil_point_index<Points>(0, 1);
+    const int UP = stencil_point_index<Points>(-1, 0);
+    const int DOWN = stencil_point_index<Points>(1, 0);
+    static_assert(LEFT >= 0 && RIGHT >= 0 && UP >= 0 && DOWN >= 0,
+                  "the gradient needs A[i][j-1], A[i][j+1], A[i-1][j] and A[i+1][j]");
+
+    sum_sq_diff<Points> combine;
+    int kernel_words = words_for((rows - HALO_ROWS) * (columns - HALO_COLUMNS));
+    perf_count_t stall = 0;
+    for (int i = 0; i < kernel_words; ) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_KERNEL_WORDS
+        if (PERF_STALLED(taps_ready<N>(taps) && taps_space<NUM_GRADIENT_FIELDS>(fields), stall)) continue;
+
+        data_vec_t tap_vec[N];
+        for (int k = 0; k < N; k++) {
+            #pragma HLS UNROLL
+            tap_vec[k] = taps[k].read();
+        }
+
+        data_vec_t field_vec[NUM_GRADIENT_FIELDS];
+        for (int l = 0; l < P; l++) {
+            #pragma HLS UNROLL
+            acc_t lane_taps[N];
+            for (int k = 0; k < N; k++) {
+                #pragma HLS UNROLL
+                lane_taps[k] = active_format::widen(tap_vec[k].lane[l]);
+            }
+            acc_t dx = (lane_taps[RIGHT] - lane_taps[LEFT]) * acc_t(0.5f);
+            acc_t dy = (lane_taps[DOWN] - lane_taps[UP]) * acc_t(0.5f);
+            acc_t magnitude = hls::sqrt(dx * dx + dy * dy);
+
+            field_vec[FIELD_SUM_SQ].lane[l] = active_format::narrow(combine(lane_taps));
+            field_vec[FIELD_DX].lane[l] = active_format::narrow(dx);
+            field_vec[FIELD_DY].lane[l] = active_format::narrow(dy);
+            field_vec[FIELD_MAGNITUDE].lane[l] = active_format::narrow(magnitude);
+            field_vec[FIELD_DIRECTION].lane[l] = active_format::narrow(acc_t(gradient_direction(dx, dy)));
+        }
+
+        for (int f = 0; f < NUM_GRADIENT_FIELDS; f++) {
+            #pragma HLS UNROLL
+            if (GRADIENT_OUTPUTS & (1 << f)) fields[f].write(field_vec[f]);
+        }
+        i++;
+    }
+    perf_report(perf, kernel_words, stall);
+}
+
+// Writes field FIELD as B, if it is selected
+template <int FIELD>
+void store_gradient_field(hls::stream<data_vec_t>& field, mem_word_t* out_mem, int rows, int columns) {
+    if (!(GRADIENT_OUTPUTS & (1 << FIELD))) return;
+    store_dense(field, out_mem, rows - HALO_ROWS, columns - HALO_COLUMNS);
+}
+
+// Valid runtime sizes: HALO_ROWS < rows, HALO_COLUMNS < columns <= MAX_COLUMNS
+void architecture_top_level_gradient(mem_word_t* A_in_mem,
+                                     mem_word_t* B_sum_sq_mem, mem_word_t* B_dx_mem,
+                                     mem_word_t* B_dy_mem, mem_word_t* B_magnitude_mem,
+                                     mem_word_t* B_direction_mem,
+                                     int rows, int columns) {
+
+    #pragma HLS INTERFACE m_axi port=A_in_mem bundle=gmem0 depth=MAX_TOTAL_WORDS
+    #pragma HLS INTERFACE m_axi port=B_sum_sq_mem bundle=gmem1 depth=MAX_KERNEL_WORDS
+    #pragma HLS INTERFACE m_axi port=B_dx_mem bundle=gmem2 depth=MAX_KERNEL_WORDS
+    #pragma HLS INTERFACE m_axi port=B_dy_mem bundle=gmem3 depth=MAX_KERNEL_WORDS
+    #pragma HLS INTERFACE m_axi port=B_magnitude_mem bundle=gmem4 depth=MAX_KERNEL_WORDS
+    #pragma HLS INTERFACE m_axi port=B_direction_mem bundle=gmem5 depth=MAX_KERNEL_WORDS
+    #pragma HLS INTERFACE s_axilite port=rows
+    #pragma HLS INTERFACE s_axilite port=columns
+    #pragma HLS INTERFACE s_axilite port=return
+
+    #pragma HLS DATAFLOW
+    TOP_LEVEL_REGION;
+
+    hls::stream<data_vec_t, 128> input_stream("input_stream");
+    #pragma HLS STREAM variable=input_stream depth=128
+
+    hls::stream<data_vec_t, 4> taps[active_points::size];
+    #pragma HLS STREAM variable=taps depth=4
+    NAME_STREAMS(taps, "tap");
+
+    hls::stream<data_vec_t, 128> fields[NUM_GRADIENT_FIELDS];
+    #pragma HLS STREAM variable=fields depth=128
+    NAME_STREAMS(fields, "field");
+
+    perf_stream_t step_perf[1][PERF_STEP_PROCESSES];
+
+    DATAFLOW_REGION;
+    DATAFLOW_PROCESS(load_dense(A_in_mem, input_stream, rows, columns));
+#if STENCIL_ENGINE == STENCIL_ENGINE_LINE_BUFFER
+    DATAFLOW_PROCESS(line_buffer_stencil<active_points>(input_stream, taps, rows, columns, step_perf[0]));
+#else
+    DATAFLOW_PROCESS(stencil_stage<grid_chain, active_points, 0>::run(input_stream, taps, rows, columns,
+                                                                      step_perf[0]));
+#endif
+    DATAFLOW_PROCESS(gradient_kernel<active_points>(taps, fields, rows, columns, step_perf[0][PERF_COMPUTE]));
+    DATAFLOW_PROCESS(store_gradient_field<FIELD_SUM_SQ>(fields[FIELD_SUM_SQ], B_sum_sq_mem, rows, columns));
+    DATAFLOW_PROCESS(store_gradient_field<FIELD_DX>(fields[FIELD_DX], B_dx_mem, rows, columns));
+    DATAFLOW_PROCESS(store_gradient_field<FIELD_DY>(fields[FIELD_DY], B_dy_mem, rows, columns));
+    DATAFLOW_PROCESS(store_gradient_field<FIELD_MAGNITUDE>(fields[FIELD_MAGNITUDE], B_magnitude_mem, rows, columns));
+    DATAFLOW_PROCESS(store_gradient_field<FIELD_DIRECTION>(fields[FIELD_DIRECTION], B_direction_mem, rows, columns));
+#if ENABLE_PERF_COUNTERS
+    DATAFLOW_PROCESS(perf_discard<1>(step_perf));
+#endif
+}
+#endif
+
+// --- RESIDENT ITERATIVE SOLVER ---
+// architecture_top_level_resident reads A once into an on-chip grid and applies
+// the stencil up to max_iterations times, each iteration from one of two
+// ping-pong grids (grid_0, grid_1) into the other, before it writes the last grid
+// to B. DRAM is only touched by the first read and the last write.
+// Every iteration is one stencil step on the whole rows x columns grid, so the
+// grid keeps its size:
+//   BOUNDARY_CROP      the border (HALO_TOP rows above, ... HALO_RIGHT columns
+//                      right of the interior) keeps the values of A
+//   the other modes    the grid is padded by one halo, as in BOUNDARY MODES, at
+//                      every iteration; the source then moves one pixel per clock
+// The kernel also returns the largest |new - old| pixel change of every iteration,
+// fused into the compute process. The loop stops after the first iteration whose
+// change is below 'tolerance' (never with tolerance 0); the number of iterations
+// run and the change of the last one are returned over s_axilite.
+// TIME_STEPS does not apply.
+const int MAX_RESIDENT_ITERATIONS = 1024; // trip counts only
+
+// A into both grids, so that in crop mode either one holds the fixed border
+void resident_load(mem_word_t* in_mem, data_vec_t grid_0[MAX_TOTAL_WORDS],
+                   data_vec_t grid_1[MAX_TOTAL_WORDS], int rows, int columns) {
+    int total_words = words_for(rows * columns);
+    for (int i = 0; i < total_words; i++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+        data_vec_t word = unpack_word(in_mem[i]);
+        grid_0[i] = word;
+        grid_1[i] = word;
+    }
+}
+
+void resident_store(data_vec_t grid[MAX_TOTAL_WORDS], mem_word_t* out_mem, int rows, int columns) {
+    int total_words = words_for(rows * columns);
+    for (int i = 0; i < total_words; i++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+        out_mem[i] = pack_word(grid[i]);
+    }
+}
+
+// Streams the grid the network works on: the grid as it is (P pixels per clock)
+// for BOUNDARY_CROP, else the grid padded by one halo (one pixel per clock)
+void resident_source(data_vec_t src[MAX_TOTAL_WORDS], hls::stream<data_vec_t>& out,
+                     int rows, int columns, int boundary) {
+    if (boundary == BOUNDARY_CROP) {
+        int total_words = words_for(rows * columns);
+        for (int i = 0; i < total_words; i++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+            out.write(src[i]);
+        }
+        return;
+    }
+
+    int padded_columns = columns + HALO_COLUMNS;
+    int padded_elements = (rows + HALO_ROWS) * padded_columns;
+    data_vec_t vec;
+    int lane = 0;
+    int pr = 0;
+    int pc = 0;
+    for (int n = 0; n < padded_elements; n++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_ELEMENTS
+        int r = boundary_index(pr - HALO_TOP, rows, boundary);
+        int c = boundary_index(pc - HALO_LEFT, columns, boundary);
+        data_t pixel = bits_to_data(0);
+        if (r >= 0 && c >= 0) {
+            int i = r * columns + c;
+            pixel = src[i / P].lane[i % P];
+        }
+        vec.lane[lane] = pixel;
+        if (lane == P - 1 || n == padded_elements - 1) {
+            out.write(vec);
+            lane = 0;
+        } else {
+            lane++;
+        }
+
+        if (pc == padded_columns - 1) {
+            pc = 0;
+            pr++;
+        } else {
+            pc++;
+        }
+    }
+}
+
+// compute_kernel with the sum of squared differences, plus the largest
+// |B[i][j] - A[i][j]| over the outputs (A[i][j] is the centre tap), taken
+// after B is rounded to data_t as the next iteration will read it
+template <class Points>
+void resident_kernel(hls::stream<data_vec_t> taps[Points::size],
+                     hls::stream<data_vec_t>& out_B,
+                     int rows, int columns, float& max_change, perf_stream_t& perf) {
+    const int N = Points::size;
+    const int CENTRE = stencil_point_index<Points>(0, 0);
+    static_assert(CENTRE >= 0, "the change needs the centre point A[i][j]");
+
+    sum_sq_diff<Points> combine;
+    float lane_max[P];
+    #pragma HLS ARRAY_PARTITION variable=lane_max complete
+    for (int l = 0; l < P; l++) {
+        #pragma HLS UNROLL
+        lane_max[l] = 0.0f;
+    }
+
+    int output_elements = (rows - HALO_ROWS) * (columns - HALO_COLUMNS);
+    int kernel_words = words_for(output_elements);
+    perf_count_t stall = 0;
+    for (int i = 0; i < kernel_words; ) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+        if (PERF_STALLED(taps_ready<N>(taps) && !out_B.full(), stall)) continue;
+
+        data_vec_t tap_vec[N];
+        for (int k = 0; k < N; k++) {
+            #pragma HLS UNROLL
+            tap_vec[k] = taps[k].read();
+        }
+
+        data_vec_t b_vec;
+        for (int l = 0; l < P; l++) {
+            #pragma HLS UNROLL
+            acc_t lane_taps[N];
+            for (int k = 0; k < N; k++) {
+                #pragma HLS UNROLL
+                lane_taps[k] = active_format::widen(tap_vec[k].lane[l]);
+            }
+            b_vec.lane[l] = active_format::narrow(combine(lane_taps));
+
+            // The last word may be partial
+            if (i * P + l < output_elements) {
+                float change = active_format::to_float(b_vec.lane[l]) -
+                               active_format::to_float(tap_vec[CENTRE].lane[l]);
+                if (change < 0.0f) change = -change;
+                if (change > lane_max[l]) lane_max[l] = change;
+            }
+        }
+
+        out_B.write(b_vec);
+        i++;
+    }
+
+    float maximum = lane_max[0];
+    for (int l = 1; l < P; l++) {
+        if (lane_max[l] > maximum) maximum = lane_max[l];
+    }
+    max_change = maximum;
+    perf_report(perf, kernel_words, stall);
+}
+
+// Writes the network's output into dst. In the padded modes it is the whole
+// grid, word for word. In crop mode it is the interior only, packed across the
+// border: every grid word takes its interior pixels from 'pending' (the network
+// words read so far) and keeps its border pixels, which dst holds since
+// resident_load.
+void resident_sink(hls::stream<data_vec_t>& in, data_vec_t dst[MAX_TOTAL_WORDS],
+                   int rows, int columns, int boundary) {
+    int total_words = words_for(rows * columns);
+    if (boundary != BOUNDARY_CROP) {
+        for (int i = 0; i < total_words; i++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+            dst[i] = in.read();
+        }
+        return;
+    }
+
+    data_t pending[2 * P];
+    #pragma HLS ARRAY_PARTITION variable=pending complete
+    int count = 0;
+    int in_words = words_for((rows - HALO_ROWS) * (columns - HALO_COLUMNS));
+    int read = 0;
+    // Row and column of lane 0 of word w
+    int r = 0;
+    int c = 0;
+    for (int w = 0; w < total_words; w++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_TOTAL_WORDS
+        #pragma HLS DEPENDENCE variable=dst inter false
+        if (count < P && read < in_words) {
+            data_vec_t vec = in.read();
+            for (int l = 0; l < P; l++) {
+                #pragma HLS UNROLL
+                pending[count + l] = vec.lane[l];
+            }
+            count += P;
+            read++;
+        }
+
+        data_vec_t word = dst[w];
+        int used = 0;
+        for (int l = 0; l < P; l++) {
+            #pragma HLS UNROLL
+            if (r >= HALO_TOP && r < rows - HALO_BOTTOM &&
+                c >= HALO_LEFT && c < columns - HALO_RIGHT) {
+                word.lane[l] = pending[used];
+                used++;
+            }
+            if (c == columns - 1) {
+                c = 0;
+                r++;
+            } else {
+                c++;
+            }
+        }
+        dst[w] = word;
+
+        for (int k = 0; k < P; k++) {
+            #pragma HLS UNROLL
+            pending[k] = pending[k + used];
+        }
+        count -= used;
+    }
+}
+
+// One iteration, src -> dst
+void resident_iteration(data_vec_t src[MAX_TOTAL_WORDS], data_vec_t dst[MAX_TOTAL_WORDS],
+                        int rows, int columns, int boundary, float& max_change) {
+    #pragma HLS DATAFLOW
+
+    hls::stream<data_vec_t, 4> grid_stream("grid_stream");
+    #pragma HLS STREAM variable=grid_stream depth=4
+
+    hls::stream<data_vec_t, 4> taps[active_points::size];
+    #pragma HLS STREAM variable=taps depth=4
+    NAME_STREAMS(taps, "tap");
+
+    hls::stream<data_vec_t, 4> result_stream("result_stream");
+    #pragma HLS STREAM variable=result_stream depth=4
+
+    perf_stream_t step_perf[1][PERF_STEP_PROCESSES];
+
+    int network_rows = (boundary == BOUNDARY_CROP) ? rows : rows + HALO_ROWS;
+    int network_columns = (boundary == BOUNDARY_CROP) ? columns : columns + HALO_COLUMNS;
+
+    DATAFLOW_REGION;
+    DATAFLOW_PROCESS(resident_source(src, grid_stream, rows, columns, boundary));
+#if STENCIL_ENGINE == STENCIL_ENGINE_LINE_BUFFER
+    DATAFLOW_PROCESS(line_buffer_stencil<active_points>(grid_stream, taps, network_rows, network_columns,
+                                                        step_perf[0]));
+#else
+    DATAFLOW_PROCESS(stencil_stage<grid_chain, active_points, 0>::run(grid_stream, taps, network_rows,
+                                                                      network_columns, step_perf[0]));
+#endif
+    DATAFLOW_PROCESS(resident_kernel<active_points>(taps, result_stream, network_rows, network_columns,
+                                                    max_change, step_perf[0][PERF_COMPUTE]));
+    DATAFLOW_PROCESS(resident_sink(result_stream, dst, rows, columns, boundary));
+#if ENABLE_PERF_COUNTERS
+    DATAFLOW_PROCESS(perf_discard<1>(step_perf));
+#endif
+}
+
+// Valid runtime sizes: rows * columns <= MAX_TOTAL_ELEMENTS (the grids hold the
+// whole frame, so rows may exceed MAX_ROWS for narrower frames), and as for
+// architecture_top_level with TIME_STEPS 1: HALO_ROWS < rows and HALO_COLUMNS < columns
+// in crop mode, columns + HALO_COLUMNS <= MAX_COLUMNS in the padded modes.
+// A and B are dense rows x columns grids of words_for(rows*columns) words.
+void architecture_top_level_resident(mem_word_t* A_in_mem, mem_word_t* B_out_mem,
+                                     int rows, int columns, int boundary,
+                                     int max_iterations, float tolerance,
+                                     int* iterations, float* last_change) {
+
+    #pragma HLS INTERFACE m_axi port=A_in_mem bundle=gmem0 depth=MAX_TOTAL_WORDS
+    #pragma HLS INTERFACE m_axi port=B_out_mem bundle=gmem1 depth=MAX_TOTAL_WORDS
+    #pragma HLS INTERFACE s_axilite port=rows
+    #pragma HLS INTERFACE s_axilite port=columns
+    #pragma HLS INTERFACE s_axilite port=boundary
+    #pragma HLS INTERFACE s_axilite port=max_iterations
+    #pragma HLS INTERFACE s_axilite port=tolerance
+    #pragma HLS INTERFACE s_axilite port=iterations
+    #pragma HLS INTERFACE s_axilite port=last_change
+    #pragma HLS INTERFACE s_axilite port=return
+
+    TOP_LEVEL_REGION;
+
+    // 64 KB each for 16 x 1024 floats; URAM, so that the BRAM stays with the
+    // network FIFOs and line buffers
+    data_vec_t grid_0[MAX_TOTAL_WORDS];
+    data_vec_t grid_1[MAX_TOTAL_WORDS];
+    #pragma HLS BIND_STORAGE variable=grid_0 type=ram_2p impl=uram
+    #pragma HLS BIND_STORAGE variable=grid_1 type=ram_2p impl=uram
+
+    // Both ping-pong directions share one copy of the iteration hardware
+    #pragma HLS ALLOCATION function instances=resident_iteration limit=1
+    #pragma HLS ALLOCATION function instances=resident_store limit=1
+
+    resident_load(A_in_mem, grid_0, grid_1, rows, columns);
+
+    int done = 0;
+    float change = 0.0f;
+    for (int t = 0; t < max_iterations; t++) {
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_RESIDENT_ITERATIONS
+        if ((t & 1) == 0) {
+            resident_iteration(grid_0, grid_1, rows, columns, boundary, change);
+        } else {
+            resident_iteration(grid_1, grid_0, rows, columns, boundary, change);
+        }
+        done = t + 1;
+        if (change < tolerance) break;
+    }
+
+    if ((done & 1) == 0) {
+        resident_store(grid_0, B_out_mem, rows, columns);
+    } else {
+        resident_store(grid_1, B_out_mem, rows, columns);
+    }
+    *iterations = done;
+    *last_change = change;
+}
+
+// --- REGION-OF-INTEREST TOP LEVEL ---
+// architecture_top_level_roi computes B only inside a list of rectangles. roi_mem
+// holds num_rois descriptors of ROI_FIELDS ints: the first A row and column of
+// the rectangle, its height and width, and a status word the kernel writes back.
+// B of a rectangle is the B of architecture_top_level (BOUNDARY_CROP) at those A
+// pixels, so a rectangle has to keep BOUNDARY_PAD_TOP rows above,
+// BOUNDARY_PAD_LEFT columns left of, and OUTPUT_HALO_ROWS-BOUNDARY_PAD_TOP rows /
+// OUTPUT_HALO_COLUMNS-BOUNDARY_PAD_LEFT columns below/right of it inside the
+// frame; one that does not is skipped with status ROI_OUTSIDE, one with height or
+// width <= 0 with ROI_EMPTY, and a computed one gets ROI_DONE. rois_done returns
+// the number of computed rectangles, so the host can tell at a glance whether
+// every descriptor was valid.
+// The rectangles run one after the other. For each one only its tile (the
+// rectangle plus the halo of TIME_STEPS steps) is read from A, one burst per
+// tile row, and goes through the unchanged network; its B is written densely,
+// height x width, at the next word of B_out_mem:
+//   ROI n starts at word sum over m < n of words_for(height_m * width_m)
+// An empty rectangle reserves no words; one outside keeps its words reserved,
+// unwritten, and only its status tells them from results. DRAM traffic and time
+// follow the ROI area, plus a pipeline fill per rectangle and the partial words
+// at both ends of every tile row.
+const int ROI_ROW = 0;
+const int ROI_COLUMN = 1;
+const int ROI_HEIGHT = 2;
+const int ROI_WIDTH = 3;
+const int ROI_STATUS = 4;
+const int ROI_FIELDS = 5;
+
+// Values of the ROI_STATUS field
+const int ROI_DONE = 1;
+const int ROI_EMPTY = 2;
+const int ROI_OUTSIDE = 3;
+const int MAX_ROIS = 64; // trip counts only
+
+// The tile_rows x tile_columns tile of A at (tile_row, tile_column). The tile
+// starts anywhere inside a word, so every row's in-tile lanes are packed through
+// 'pending' into the P-pixel words the network expects, running across rows.
+void load_roi(mem_word_t* in_mem, hls::stream<data_vec_t>& out, int columns,
+              int tile_row, int tile_column, int tile_rows, int tile_columns) {
+    data_t pending[2 * PARALLEL_FACTOR];
+    #pragma HLS ARRAY_PARTITION variable=pending complete
+    int count = 0;
+
+    for (int tr = 0; tr < tile_rows; tr++) {
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_ROWS
+        int first_pixel = (tile_row + tr) * columns + tile_column;
+        int first_word = first_pixel / P;
+        int row_words = (first_pixel + tile_columns - 1) / P - first_word + 1;
+
+        for (int w = 0; w < row_words; w++) {
+            #pragma HLS PIPELINE II=1
+            #pragma HLS LOOP_TRIPCOUNT max=MAX_COLUMNS/PARALLEL_FACTOR+1
+            data_vec_t vec = unpack_word(in_mem[first_word + w]);
+            int c0 = (first_word + w) * P - first_pixel;
+
+            int pos = count;
+            for (int l = 0; l < P; l++) {
+                #pragma HLS UNROLL
+                if (c0 + l >= 0 && c0 + l < tile_columns) {
+                    pending[pos] = vec.lane[l];
+                    pos++;
+                }
+            }
+
+            if (pos >= P) {
+                data_vec_t data_out;
+                for (int l = 0; l < P; l++) {
+                    #pragma HLS UNROLL
+                    data_out.lane[l] = pending[l];
+                    pending[l] = pending[l + P];
+                }
+                out.write(data_out);
+                count = pos - P;
+            } else {
+                count = pos;
+            }
+        }
+    }
+
+    // Flush the last, partially filled word
+    if (count > 0) {
+        data_vec_t data_out;
+        for (int l = 0; l < P; l++) {
+            #pragma HLS UNROLL
+            data_out.lane[l] = pending[l];
+        }
+        out.write(data_out);
+    }
+}
+
+// B of one rectangle, densely from word out_offset on
+void store_roi(hls::stream<data_vec_t>& out_stream, mem_word_t* out_mem, int out_offset,
+               int height, int width) {
+    int output_words = words_for(height * width);
+    for (int i = 0; i < output_words; i++) {
+        #pragma HLS PIPELINE II=1
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_OUTPUT_WORDS
+        out_mem[out_offset + i] = pack_word(out_stream.read());
+    }
+}
+
+void stencil_roi_dataflow(mem_word_t* A_in_mem, mem_word_t* B_out_mem, int columns,
+                          int row, int column, int height, int width, int out_offset) {
+    #pragma HLS DATAFLOW
+
+    hls::stream<data_vec_t, 128> input_stream("input_stream");
+    #pragma HLS STREAM variable=input_stream depth=128
+
+    hls::stream<data_vec_t, 128> output_stream("output_stream");
+    #pragma HLS STREAM variable=output_stream depth=128
+
+    perf_stream_t step_perf[TIME_STEPS][PERF_STEP_PROCESSES];
+
+    int tile_rows = height + OUTPUT_HALO_ROWS;
+    int tile_columns = width + OUTPUT_HALO_COLUMNS;
+
+    DATAFLOW_REGION;
+    DATAFLOW_PROCESS(load_roi(A_in_mem, input_stream, columns, row - BOUNDARY_PAD_TOP,
+                              column - BOUNDARY_PAD_LEFT, tile_rows, tile_columns));
+    DATAFLOW_PROCESS(stencil_cascade<0, TIME_STEPS>::run(input_stream, output_stream,
+                                                         tile_rows, tile_columns, step_perf));
+    DATAFLOW_PROCESS(store_roi(output_stream, B_out_mem, out_offset, height, width));
+#if ENABLE_PERF_COUNTERS
+    DATAFLOW_PROCESS(perf_discard<TIME_STEPS>(step_perf));
+#endif
+}
+
+// Valid runtime sizes: as architecture_top_level. ENABLE_STATS and the boundary
+// modes do not apply.
+void architecture_top_level_roi(mem_word_t* A_in_mem, mem_word_t* B_out_mem, int* roi_mem,
+                                int rows, int columns, int num_rois, int* rois_done) {
+
+    #pragma HLS INTERFACE m_axi port=A_in_mem bundle=gmem0 depth=MAX_TOTAL_WORDS
+    #pragma HLS INTERFACE m_axi port=B_out_mem bundle=gmem1 depth=MAX_OUTPUT_WORDS
+    #pragma HLS INTERFACE m_axi port=roi_mem bundle=gmem2 depth=MAX_ROIS*ROI_FIELDS
+    #pragma HLS INTERFACE s_axilite port=rows
+    #pragma HLS INTERFACE s_axilite port=columns
+    #pragma HLS INTERFACE s_axilite port=num_rois
+    #pragma HLS INTERFACE s_axilite port=rois_done
+    #pragma HLS INTERFACE s_axilite port=return
+
+    TOP_LEVEL_REGION;
+
+    int done = 0;
+    int out_offset = 0;
+    for (int n = 0; n < num_rois; n++) {
+        #pragma HLS LOOP_TRIPCOUNT max=MAX_ROIS
+        int row = roi_mem[n * ROI_FIELDS + ROI_ROW];
+        int column = roi_mem[n * ROI_FIELDS + ROI_COLUMN];
+        int height = roi_mem[n * ROI_FIELDS + ROI_HEIGHT];
+        int width = roi_mem[n * ROI_FIELDS + ROI_WIDTH];
+        if (height <= 0 || width <= 0) {
+            roi_mem[n * ROI_FIELDS + ROI_STATUS] = ROI_EMPTY;
+            continue;
+        }
+
+        bool inside = row >= BOUNDARY_PAD_TOP && column >= BOUNDARY_PAD_LEFT &&
+                      row + height <= rows - (OUTPUT_HALO_ROWS - BOUNDARY_PAD_TOP) &&
+                      column + width <= columns - (OUTPUT_HALO_COLUMNS - BOUNDARY_PAD_LEFT);
+        if (inside) {
+            stencil_roi_dataflow(A_in_mem, B_out_mem, columns, row, column, height, width, out_offset);
+            done++;
+        }
+        roi_mem[n * ROI_FIELDS + ROI_STATUS] = inside ? ROI_DONE : ROI_OUTSIDE;
+        out_offset += words_for(height * width);
+    }
+    *rois_done = done;
+}
@@ -0,0 +1,185 @@
+#ifndef PIXEL_FORMAT_H
+#define PIXEL_FORMAT_H
+
+#include "ap_int.h"
+#include "ap_fixed.h"
+
+// --- PIXEL FORMATS ---
+// A pixel format describes how pixels are stored in DRAM and in the on-chip
+// streams (storage_t, WIDTH bits each) and in which type compute_kernel does
+// its arithmetic (acc_t). Shared by first_try_cong.cpp and cong_testbench.cpp.
+//
+//   from_bits / to_bits : storage_t <-> WIDTH raw bits of an AXI word
+//   widen / narrow      : storage_t <-> acc_t
+//   to_float / from_float : conversions used by the testbench (to_float also by
+//                           the kernel's output statistics)
+//
+// Select the format with -DDATA_FORMAT=N:
+//   0: float                                (32 bit, the original design)
+//   1: ap_fixed<FIXED_W, FIXED_I>           computed in ap_fixed<FIXED_ACC_W, FIXED_ACC_I>
+//   2: IEEE half (binary16) storage         computed in float
+//   3: bfloat16 storage                     computed in float
+#define DATA_FORMAT_FLOAT 0
+#define DATA_FORMAT_FIXED 1
+#define DATA_FORMAT_HALF 2
+#define DATA_FORMAT_BFLOAT16 3
+
+#ifndef DATA_FORMAT
+#define DATA_FORMAT DATA_FORMAT_FLOAT
+#endif
+
+// Default fixed-point format: 16-bit pixels in [-8, 8) with 12 fraction bits,
+// sized for inputs normalised to [0, 1) (B <= 4 for the 5-point stencil)
+#ifndef FIXED_W
+#define FIXED_W 16
+#endif
+#ifndef FIXED_I
+#define FIXED_I 4
+#endif
+#ifndef FIXED_ACC_W
+#define FIXED_ACC_W 32
+#endif
+#ifndef FIXED_ACC_I
+#define FIXED_ACC_I 8
+#endif
+
+inline unsigned int float_as_bits(float value) {
+    union { unsigned int u; float f; } conv;
+    conv.f = value;
+    return conv.u;
+}
+
+inline float bits_as_float(unsigned int bits) {
+    union { unsigned int u; float f; } conv;
+    conv.u = bits;
+    return conv.f;
+}
+
+struct float_format {
+    typedef float storage_t;
+    typedef float acc_t;
+    static const int WIDTH = 32;
+
+    static storage_t from_bits(ap_uint<WIDTH> bits) { return bits_as_float(bits.to_uint()); }
+    static ap_uint<WIDTH> to_bits(storage_t value) { return float_as_bits(value); }
+    static acc_t widen(storage_t value) { return value; }
+    static storage_t narrow(acc_t value) { return value; }
+    static float to_float(storage_t value) { return value; }
+    static storage_t from_float(float value) { return value; }
+};
+
+// ap_fixed pixels; the accumulator is wider so the squares and sums do not wrap
+template <int W, int I, int ACC_W, int ACC_I>
+struct fixed_format {
+    typedef ap_fixed<W, I> storage_t;
+    typedef ap_fixed<ACC_W, ACC_I> acc_t;
+    static const int WIDTH = W;
+
+    static storage_t from_bits(ap_uint<WIDTH> bits) {
+        storage_t value;
+        value.range(W - 1, 0) = bits;
+        return value;
+    }
+    static ap_uint<WIDTH> to_bits(storage_t value) { return value.range(W - 1, 0); }
+    static acc_t widen(storage_t value) { return acc_t(value); }
+    static storage_t narrow(acc_t value) { return storage_t(value); }
+    static float to_float(storage_t value) { return value.to_float(); }
+    static storage_t from_float(float value) { return storage_t(value); }
+};
+
+// IEEE 754 binary16 kept as raw bits; widened to float for the arithmetic
+struct half_format {
+    typedef ap_uint<16> storage_t;
+    typedef float acc_t;
+    static const int WIDTH = 16;
+
+    static storage_t from_bits(ap_uint<WIDTH> bits) { return bits; }
+    static ap_uint<WIDTH> to_bits(storage_t value) { return value; }
+
+    static acc_t widen(storage_t value) {
+        unsigned int h = value.to_uint();
+        unsigned int sign = (h & 0x8000) << 16;
+        unsigned int exponent = (h >> 10) & 0x1F;
+        unsigned int mantissa = h & 0x3FF;
+        if (exponent == 0) {
+            // Zero or subnormal: mantissa * 2^-24, exact in float
+            float magnitude = (float)mantissa * 5.9604644775390625e-8f;
+            return sign ? -magnitude : magnitude;
+        }
+        if (exponent == 31) {
+            return bits_as_float(sign | 0x7F800000 | (mantissa << 13));
+        }
+        return bits_as_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+    }
+
+    // Round to nearest, ties to even
+    static storage_t narrow(acc_t value) {
+        unsigned int x = float_as_bits(value);
+        unsigned int sign = (x >> 16) & 0x8000;
+        unsigned int float_exponent = (x >> 23) & 0xFF;
+        unsigned int mantissa = x & 0x7FFFFF;
+        int exponent = (int)float_exponent - 112;
+
+        if (float_exponent == 0xFF) {
+            return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+        }
+        if (exponent >= 31) {
+            return sign | 0x7C00;
+        }
+        if (exponent <= 0) {
+            if (exponent < -10) return sign;
+            mantissa |= 0x800000;
+            int shift = 14 - exponent;
+            unsigned int half_mantissa = mantissa >> shift;
+            unsigned int rest = mantissa & ((1u << shift) - 1);
+            unsigned int halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half_mantissa & 1))) half_mantissa++;
+            return sign | half_mantissa;
+        }
+        unsigned int half = sign | ((unsigned int)exponent << 10) | (mantissa >> 13);
+        unsigned int rest = mantissa & 0x1FFF;
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+        return half;
+    }
+
+    static float to_float(storage_t value) { return widen(value); }
+    static storage_t from_float(float value) { return narrow(value); }
+};
+
+// bfloat16 = the upper half of a float, kept as raw bits; widened to float
+struct bfloat16_format {
+    typedef ap_uint<16> storage_t;
+    typedef float acc_t;
+    static const int WIDTH = 16;
+
+    static storage_t from_bits(ap_uint<WIDTH> bits) { return bits; }
+    static ap_uint<WIDTH> to_bits(storage_t value) { return value; }
+    static acc_t widen(storage_t value) { return bits_as_float(value.to_uint() << 16); }
+
+    // Round to nearest, ties to even
+    static storage_t narrow(acc_t value) {
+        unsigned int x = float_as_bits(value);
+        if ((x & 0x7F800000) == 0x7F800000 && (x & 0x7FFFFF)) {
+            return (x >> 16) | 0x40;
+        }
+        x += 0x7FFF + ((x >> 16) & 1);
+        return x >> 16;
+    }
+
+    static float to_float(storage_t value) { return widen(value); }
+    static storage_t from_float(float value) { return narrow(value); }
+};
+
+#if DATA_FORMAT == DATA_FORMAT_FLOAT
+typedef float_format active_format;
+#elif DATA_FORMAT == DATA_FORMAT_FIXED
+typedef fixed_format<FIXED_W, FIXED_I, FIXED_ACC_W, FIXED_ACC_I> active_format;
+#elif DATA_FORMAT == DATA_FORMAT_HALF
+typedef half_format active_format;
+#elif DATA_FORMAT == DATA_FORMAT_BFLOAT16
+typedef bfloat16_format active_format;
+#else
+#error "Unknown DATA_FORMAT"
+#endif
+
+#endif
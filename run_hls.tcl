@@ -4,10 +4,34 @@ open_project -reset cong_stencil_project_2
 
 # 2. Add Design Files
 # NOTE: Ensure that .cpp files are in the same directory as this script
-add_files first_try_cong.cpp
-add_files -tb cong_testbench.cpp
+# Pixels per clock = pixels per AXI word on gmem0/gmem1 (1, 2, 4, 8, 16)
+set PARALLEL_FACTOR 1
+# Stencil engine: 0 = splitter/filter chain, 1 = line buffer (see compare_engines.tcl)
+set STENCIL_ENGINE 0
+# Stencil shape generated by stencil_network: 5, 9, 13 or 6 (asymmetric upwind)
+set STENCIL_SHAPE 5
+# Stencil time steps applied on-chip per DRAM pass (temporal blocking)
+set TIME_STEPS 1
+# Pixel format: 0 = float, 1 = ap_fixed<16,4>, 2 = half, 3 = bfloat16 (see pixel_format.h)
+set DATA_FORMAT 0
+# 1 = busy/stall counters readable in the s_axilite array perf_counters
+set ENABLE_PERF_COUNTERS 0
+# 1 = sum/min/max/histogram of B returned over s_axilite, writing B optional
+set ENABLE_STATS 0
+# 1 = count of complete B rows kept in DRAM (row_progress) while B is written;
+#     each row is a manual burst whose write response is awaited before the
+#     counter write, which the cosim run below exercises (needs Vitis HLS 2022.1+)
+set ENABLE_ROW_PROGRESS 0
+set CFLAGS "-DPARALLEL_FACTOR=$PARALLEL_FACTOR -DSTENCIL_ENGINE=$STENCIL_ENGINE -DSTENCIL_SHAPE=$STENCIL_SHAPE -DTIME_STEPS=$TIME_STEPS -DDATA_FORMAT=$DATA_FORMAT -DENABLE_PERF_COUNTERS=$ENABLE_PERF_COUNTERS -DENABLE_STATS=$ENABLE_STATS -DENABLE_ROW_PROGRESS=$ENABLE_ROW_PROGRESS"
+add_files first_try_cong.cpp -cflags $CFLAGS
+add_files -tb cong_testbench.cpp -cflags $CFLAGS
 
 # 3. Set Top-Level Function
+# (architecture_top_level_strips = 4 compute units on column strips, PARALLEL_FACTOR 1 only)
+# (architecture_top_level_axis = free-running AXI4-Stream frames, ap_ctrl_none)
+# (architecture_top_level_gradient = sum of squares, dx, dy, magnitude, direction; see GRADIENT_OUTPUTS)
+# (architecture_top_level_resident = iterates on an on-chip grid, writes back the last one)
+# (architecture_top_level_roi = B only inside a DRAM list of rectangles, packed per rectangle)
 set_top architecture_top_level
 
 # ########################################################
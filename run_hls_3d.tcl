@@ -0,0 +1,33 @@
+# 1. Create Project
+# This will create a folder named "cong_stencil_3d"
+open_project -reset cong_stencil_3d
+
+# 2. Add Design Files
+# 3D 7-point stencil (see cong_3d.cpp), float, one voxel per clock
+add_files cong_3d.cpp
+add_files -tb cong_3d_tb.cpp
+
+# 3. Set Top-Level Function
+set_top architecture_top_level_3d
+
+# 4. Create Solution
+open_solution -flow_target vitis -reset "solution1"
+
+# 5. Set Board & Clock
+# Board: ZCU104 (xczu7ev-ffvc1156-2-e)
+set_part {xczu7ev-ffvc1156-2-e}
+create_clock -period 4.5 -name default
+
+# --- CONFIGURATION / OPTIMIZATION COMMANDS ---
+config_compile -pipeline_loops 0
+config_compile -unsafe_math_optimizations
+config_storage fifo -impl lutram
+
+# 6. Run C Simulation, Synthesis and Co-Simulation
+csim_design
+csynth_design
+cosim_design -trace_level all -enable_dataflow_profiling
+
+exit
+
+#vitis-run --mode hls --tcl run_hls_3d.tcl
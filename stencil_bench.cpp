@@ -0,0 +1,270 @@
+// Throughput/latency benchmark and regression run of the HLS top levels in
+// C-simulation. Sweeps frame sizes and input distributions, checks every run
+// against stencil_golden.h and appends one CSV row per run: C-sim wall time,
+// pixels per second, error statistics and, with --csynth, the latency, II and
+// resources of the matching csynth_design report.
+//
+// Built against one top level, with the same -D flags as the kernel:
+//   memory mapped (default)  first_try_cong.cpp, any PARALLEL_FACTOR, DATA_FORMAT,
+//                            STENCIL_SHAPE, TIME_STEPS and STENCIL_ENGINE
+//   stream                   cong_no_lcs.cpp (-DBENCH_TARGET=1), float 5-point
+//
+//   g++ -O2 -I$XILINX_HLS/include -DPARALLEL_FACTOR=4 first_try_cong.cpp stencil_bench.cpp -o stencil_bench
+//   g++ -O2 -I$XILINX_HLS/include -DBENCH_TARGET=1 cong_no_lcs.cpp stencil_bench.cpp -o stencil_bench_stream
+//   ./stencil_bench [--csv file] [--label name] [--csynth csynth.xml] [--repetitions n] [rows columns]
+//
+// bench_suite.sh builds and runs every variant into one CSV.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "ap_int.h"
+#include "hls_stream.h"
+
+// Top level under test: TARGET_MEMORY (default) or TARGET_STREAM of stencil_driver.h
+#ifndef BENCH_TARGET
+#define BENCH_TARGET 0
+#endif
+#define DRIVER_TARGET BENCH_TARGET
+#include "stencil_driver.h"
+
+#ifndef STENCIL_ENGINE
+#define STENCIL_ENGINE 0
+#endif
+
+// MAX_ROWS of the top levels only bounds trip counts, so the sweep goes past it
+const int NUM_BENCH_SIZES = 4;
+const int BENCH_SIZES[NUM_BENCH_SIZES][2] = {
+    {16, 64}, {16, 1024}, {64, 1024}, {256, 1024}
+};
+
+// Scale of each input distribution (pixel = level * scale, level in [0, 256)),
+// sized so that TIME_STEPS <= 2 stays inside the format's range. Ramp, random
+// and constant use the testbench's INPUT_SCALE.
+#if DATA_FORMAT == DATA_FORMAT_FLOAT
+const float INPUT_SCALES[NUM_INPUT_DISTRIBUTIONS] = {1.0f, 1.0f, 1.0f, 1e-41f, 1048576.0f};
+#elif DATA_FORMAT == DATA_FORMAT_FIXED
+// No denormals in fixed point: "denormal" is a few LSBs of ap_fixed<16,4>
+const float INPUT_SCALES[NUM_INPUT_DISTRIBUTIONS] = {1.0f / 1024, 1.0f / 1024, 1.0f / 1024, 1.0f / 65536, 1.0f / 512};
+#elif DATA_FORMAT == DATA_FORMAT_HALF
+const float INPUT_SCALES[NUM_INPUT_DISTRIBUTIONS] = {1.0f / 256, 1.0f / 256, 1.0f / 256, 1.0f / 16777216, 1.0f / 64};
+#else
+const float INPUT_SCALES[NUM_INPUT_DISTRIBUTIONS] = {1.0f / 256, 1.0f / 256, 1.0f / 256, 1e-41f, 1048576.0f};
+#endif
+
+// The large scales above are for the 5-point stencil (4 squared differences);
+// stencils with more points get proportionally smaller large inputs.
+static float input_scale(int distribution) {
+    if (distribution == INPUT_LARGE) {
+        return INPUT_SCALES[INPUT_LARGE] * 4.0f / (NUM_POINTS - 1);
+    }
+    return INPUT_SCALES[distribution];
+}
+
+// Prototype of the top level under test
+#if BENCH_TARGET == TARGET_STREAM
+void architecture_top_level(hls::stream<data_t>& A_in, hls::stream<data_t>& B_out,
+                            int rows, int columns);
+#else
+void architecture_top_level(mem_word_t* A_in_mem, mem_word_t* B_out_mem,
+                            int rows, int columns, int boundary, int output_pitch);
+#endif
+
+// Values of one csynth.xml, "-" where the report has no such tag
+struct csynth_report {
+    std::string clock_ns = "-";
+    std::string latency = "-";
+    std::string interval = "-";
+    std::string bram_18k = "-";
+    std::string dsp = "-";
+    std::string ff = "-";
+    std::string lut = "-";
+    std::string uram = "-";
+};
+
+// First match of <tag>value</tag>, as report_value in compare_engines.tcl
+static std::string report_value(const std::string& xml, const char* tag) {
+    std::string open = std::string("<") + tag + ">";
+    size_t start = xml.find(open);
+    if (start == std::string::npos) return "-";
+    start += open.size();
+    size_t end = xml.find('<', start);
+    if (end == std::string::npos) return "-";
+    return xml.substr(start, end - start);
+}
+
+static bool read_csynth_report(const char* path, csynth_report& report) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        printf("[BENCH] Cannot open csynth report %s\n", path);
+        return false;
+    }
+    std::string xml;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        xml.append(buffer, n);
+    }
+    fclose(f);
+
+    // Resources from <AreaEstimates> only: <AvailableResources> repeats the tags
+    std::string area;
+    size_t area_start = xml.find("<AreaEstimates>");
+    size_t area_end = xml.find("</AreaEstimates>");
+    if (area_start != std::string::npos && area_end != std::string::npos) {
+        area = xml.substr(area_start, area_end - area_start);
+    }
+    report.clock_ns = report_value(xml, "EstimatedClockPeriod");
+    report.latency = report_value(xml, "Worst-caseLatency");
+    report.interval = report_value(xml, "Interval-max");
+    report.bram_18k = report_value(area, "BRAM_18K");
+    report.dsp = report_value(area, "DSP");
+    report.ff = report_value(area, "FF");
+    report.lut = report_value(area, "LUT");
+    report.uram = report_value(area, "URAM");
+    return true;
+}
+
+// Runs the top level 'repetitions' times on A; returns the best wall time in
+// seconds and the output of the last run in B.
+static double time_top_level(const std::vector<data_t>& A, std::vector<data_t>& B,
+                             int rows, int columns, int repetitions) {
+    double best = 1e30;
+#if BENCH_TARGET == TARGET_STREAM
+    for (int r = 0; r < repetitions; r++) {
+        hls::stream<data_t> A_in("A_in");
+        hls::stream<data_t> B_out("B_out");
+        for (size_t i = 0; i < A.size(); i++) {
+            A_in.write(A[i]);
+        }
+        auto start = std::chrono::steady_clock::now();
+        architecture_top_level(A_in, B_out, rows, columns);
+        auto stop = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(stop - start).count());
+        for (size_t i = 0; i < B.size(); i++) {
+            B[i] = B_out.read();
+        }
+    }
+#else
+    std::vector<mem_word_t> A_words((A.size() + P - 1) / P, 0);
+    std::vector<mem_word_t> B_words((B.size() + P - 1) / P, 0);
+    pack_words(A, A_words);
+    for (int r = 0; r < repetitions; r++) {
+        auto start = std::chrono::steady_clock::now();
+        architecture_top_level(A_words.data(), B_words.data(), rows, columns, 0, 0);
+        auto stop = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(stop - start).count());
+    }
+    unpack_words(B_words, B);
+#endif
+    return best;
+}
+
+struct bench_options {
+    const char* csv_path = "stencil_bench.csv";
+    const char* label = "local";
+    int repetitions = 1;
+    csynth_report csynth;
+};
+
+// One frame size and distribution; returns the number of mismatches
+static long run_bench(int rows, int columns, int distribution, const bench_options& options, FILE* csv) {
+    halo_t h = stencil_halo();
+    int output_rows = rows - TIME_STEPS * (h.top + h.bottom);
+    int output_columns = columns - TIME_STEPS * (h.left + h.right);
+    if (output_rows < 1 || output_columns < 1 || columns > MAX_COLUMNS) {
+        printf("[BENCH] Skipping %d x %d: outside the kernel's frame limits\n", rows, columns);
+        return 0;
+    }
+
+    // Inputs and intermediate steps rounded to DATA_FORMAT so the golden model
+    // sees the kernel's pixels
+    std::vector<data_t> A((size_t)rows * columns);
+    std::vector<data_t> B((size_t)output_rows * output_columns);
+    std::vector<data_t> golden;
+    fill_input(A, distribution, input_scale(distribution), 1);
+    for (size_t i = 0; i < A.size(); i++) {
+        A[i] = round_to_format(A[i]);
+    }
+    golden_stencil_steps(A, golden, rows, columns, TIME_STEPS, round_to_format);
+
+    double seconds = time_top_level(A, B, rows, columns, options.repetitions);
+    double pixels_per_second = (double)rows * columns / seconds;
+    error_stats errors = compare_outputs(B, golden, TOLERANCE);
+
+    printf("%6d x %-5d %-9s %9.3f ms %10.3g px/s   max|err| %-10g max rel %-10g %s\n",
+           rows, columns, input_distribution_name(distribution), seconds * 1e3,
+           pixels_per_second, errors.max_abs_error, errors.max_rel_error,
+           errors.mismatches == 0 ? "ok" : "MISMATCH");
+
+    const csynth_report& r = options.csynth;
+    fprintf(csv, "%s,%s,%d,%d,%d,%d,%d,%d,%d,%s,%.6f,%.6g,%.6g,%.6g,%ld,%s,%s,%s,%s,%s,%s,%s,%s\n",
+            options.label, target_name(), DATA_FORMAT, P, STENCIL_SHAPE, TIME_STEPS, STENCIL_ENGINE,
+            rows, columns, input_distribution_name(distribution),
+            seconds, pixels_per_second, errors.max_abs_error, errors.max_rel_error, errors.mismatches,
+            r.clock_ns.c_str(), r.latency.c_str(), r.interval.c_str(),
+            r.bram_18k.c_str(), r.dsp.c_str(), r.ff.c_str(), r.lut.c_str(), r.uram.c_str());
+    return errors.mismatches;
+}
+
+int main(int argc, char** argv) {
+    bench_options options;
+    std::vector<int> sizes;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--csv") == 0 && a + 1 < argc) {
+            options.csv_path = argv[++a];
+        } else if (strcmp(argv[a], "--label") == 0 && a + 1 < argc) {
+            options.label = argv[++a];
+        } else if (strcmp(argv[a], "--repetitions") == 0 && a + 1 < argc) {
+            options.repetitions = std::max(1, atoi(argv[++a]));
+        } else if (strcmp(argv[a], "--csynth") == 0 && a + 1 < argc) {
+            if (!read_csynth_report(argv[++a], options.csynth)) return 2;
+        } else if (argv[a][0] != '-') {
+            sizes.push_back(atoi(argv[a]));
+        } else {
+            printf("usage: %s [--csv file] [--label name] [--csynth csynth.xml] [--repetitions n] [rows columns]\n",
+                   argv[0]);
+            return 2;
+        }
+    }
+    if (sizes.size() == 1) sizes.clear();
+
+    FILE* csv = fopen(options.csv_path, "a");
+    if (csv == NULL) {
+        printf("[BENCH] Cannot open %s\n", options.csv_path);
+        return 2;
+    }
+    fseek(csv, 0, SEEK_END);
+    if (ftell(csv) == 0) {
+        fprintf(csv, "label,target,data_format,parallel_factor,stencil_shape,time_steps,stencil_engine,"
+                     "rows,columns,distribution,seconds,pixels_per_second,max_abs_error,max_rel_error,"
+                     "mismatches,csynth_clock_ns,csynth_latency,csynth_interval,"
+                     "bram_18k,dsp,ff,lut,uram\n");
+    }
+
+    printf("[BENCH] %s top level, DATA_FORMAT %d, %d pixels per word, %d-point stencil, %d time steps\n",
+           target_name(), DATA_FORMAT, P, STENCIL_SHAPE, TIME_STEPS);
+
+    long errors = 0;
+    for (int d = 0; d < NUM_INPUT_DISTRIBUTIONS; d++) {
+        if (sizes.size() >= 2) {
+            errors += run_bench(sizes[0], sizes[1], d, options, csv);
+        } else {
+            for (int t = 0; t < NUM_BENCH_SIZES; t++) {
+                errors += run_bench(BENCH_SIZES[t][0], BENCH_SIZES[t][1], d, options, csv);
+            }
+        }
+    }
+    fclose(csv);
+
+    if (errors == 0) {
+        printf("\n--- TEST PASSED ---\n");
+    } else {
+        printf("\n--- TEST FAILED: %ld mismatches ---\n", errors);
+    }
+    return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+#ifndef STENCIL_CHAIN_H
+#define STENCIL_CHAIN_H
+
+// --- STENCIL GENERATOR ---
+// Builds the splitter/filter/FIFO chain of Figure 5 (411) for any list of
+// stencil points; shared by the 2D network of first_try_cong.cpp and the 3D one
+// of cong_3d.cpp so that their FIFO sizing rules cannot drift apart. Stage s
+// taps the point with the s-th largest linear offset (the one that arrives
+// first); its splitter forwards the stream to stage s+1 through a FIFO that has
+// to hold the pixels between the two taps, and the last splitter's copy is
+// drained. FIFO storage is chosen from depth x width.
+//
+// The kernel describes its chain with a class Chain:
+//   Chain::element_t                     stream element, ELEMENT_PIXELS pixels of
+//   Chain::ELEMENT_PIXELS                ELEMENT_BITS bits in all
+//   Chain::ELEMENT_BITS
+//   Chain::linear_offset<Points>(k)      stream distance of point k in pixels
+//   Chain::tap<Points, STAGE>(in, out_to_next, taps, args...)
+//                                        splitter and filter of stage STAGE
+//   Chain::discard(in, args...)          drains the copy after the last stage
+// args... are the runtime arguments of the kernel's processes (sizes, perf
+// streams), passed through unchanged.
+//
+// Include after hls_stream.h and csim_dataflow.h.
+
+enum fifo_impl_t { FIFO_IMPL_NONE, FIFO_IMPL_LUTRAM, FIFO_IMPL_BRAM, FIFO_IMPL_URAM };
+
+const int LUTRAM_FIFO_MAX_BITS = 2048;           // SRL/LUTRAM up to here
+const int BRAM_FIFO_MAX_BITS = 8 * 36 * 1024;    // up to 8 BRAM36, URAM beyond
+
+template <class Chain, class Points> constexpr int stencil_point_at_stage(int stage) {
+    for (int k = 0; k < Points::size; k++) {
+        int rank = 0;
+        for (int m = 0; m < Points::size; m++) {
+            if (Chain::template linear_offset<Points>(m) > Chain::template linear_offset<Points>(k)) rank++;
+        }
+        if (rank == stage) return k;
+    }
+    return -1;
+}
+
+template <class Chain, class Points> constexpr bool stencil_points_distinct() {
+    for (int s = 0; s < Points::size; s++) {
+        if (stencil_point_at_stage<Chain, Points>(s) < 0) return false;
+    }
+    return true;
+}
+
+// Depth in elements of the FIFO between stage and stage+1 (none after the last stage)
+template <class Chain, class Points> constexpr int stencil_fifo_depth(int stage) {
+    if (stage >= Points::size - 1) return 0;
+    int pixels = Chain::template linear_offset<Points>(stencil_point_at_stage<Chain, Points>(stage)) -
+                 Chain::template linear_offset<Points>(stencil_point_at_stage<Chain, Points>(stage + 1));
+    int depth = (pixels + Chain::ELEMENT_PIXELS - 1) / Chain::ELEMENT_PIXELS;
+    return depth < 2 ? 2 : depth;
+}
+
+template <class Chain, class Points> constexpr int stencil_fifo_impl(int stage) {
+    if (stage == Points::size - 1) return FIFO_IMPL_NONE;
+    int bits = stencil_fifo_depth<Chain, Points>(stage) * Chain::ELEMENT_BITS;
+    if (bits <= LUTRAM_FIFO_MAX_BITS) return FIFO_IMPL_LUTRAM;
+    if (bits <= BRAM_FIFO_MAX_BITS) return FIFO_IMPL_BRAM;
+    return FIFO_IMPL_URAM;
+}
+
+// Names of a stage's streams in C-simulation reports: "fifo_03", "s_to_f_03"
+template <int STAGE>
+struct stencil_stage_names {
+    static constexpr char fifo[] = {'f', 'i', 'f', 'o', '_',
+                                    char('0' + STAGE / 10), char('0' + STAGE % 10), 0};
+    static constexpr char s_to_f[] = {'s', '_', 't', 'o', '_', 'f', '_',
+                                      char('0' + STAGE / 10), char('0' + STAGE % 10), 0};
+};
+
+template <int STAGE> constexpr char stencil_stage_names<STAGE>::fifo[];
+template <int STAGE> constexpr char stencil_stage_names<STAGE>::s_to_f[];
+
+// stencil_stage<Chain, Points, 0>::run(in, taps, args...) is the whole chain
+template <class Chain, class Points, int STAGE,
+          int IMPL = stencil_fifo_impl<Chain, Points>(STAGE),
+          int DEPTH = stencil_fifo_depth<Chain, Points>(STAGE)>
+struct stencil_stage;
+
+template <class Chain, class Points, int STAGE, int DEPTH>
+struct stencil_stage<Chain, Points, STAGE, FIFO_IMPL_LUTRAM, DEPTH> {
+    typedef typename Chain::element_t element_t;
+
+    template <class... Args>
+    static void run(hls::stream<element_t>& in, hls::stream<element_t> taps[Points::size], Args... args) {
+        #pragma HLS INLINE
+        hls::stream<element_t, DEPTH> fifo(stencil_stage_names<STAGE>::fifo);
+        #pragma HLS STREAM variable=fifo depth=DEPTH
+        #pragma HLS BIND_STORAGE variable=fifo type=fifo impl=lutram
+
+        DATAFLOW_REGION;
+        DATAFLOW_PROCESS(Chain::template tap<Points, STAGE>(in, fifo, taps, args...));
+        DATAFLOW_PROCESS(stencil_stage<Chain, Points, STAGE + 1>::run(fifo, taps, args...));
+    }
+};
+
+template <class Chain, class Points, int STAGE, int DEPTH>
+struct stencil_stage<Chain, Points, STAGE, FIFO_IMPL_BRAM, DEPTH> {
+    typedef typename Chain::element_t element_t;
+
+    template <class... Args>
+    static void run(hls::stream<element_t>& in, hls::stream<element_t> taps[Points::size], Args... args) {
+        #pragma HLS INLINE
+        hls::stream<element_t, DEPTH> fifo(stencil_stage_names<STAGE>::fifo);
+        #pragma HLS STREAM variable=fifo depth=DEPTH
+        #pragma HLS BIND_STORAGE variable=fifo type=fifo impl=bram
+
+        DATAFLOW_REGION;
+        DATAFLOW_PROCESS(Chain::template tap<Points, STAGE>(in, fifo, taps, args...));
+        DATAFLOW_PROCESS(stencil_stage<Chain, Points, STAGE + 1>::run(fifo, taps, args...));
+    }
+};
+
+template <class Chain, class Points, int STAGE, int DEPTH>
+struct stencil_stage<Chain, Points, STAGE, FIFO_IMPL_URAM, DEPTH> {
+    typedef typename Chain::element_t element_t;
+
+    template <class... Args>
+    static void run(hls::stream<element_t>& in, hls::stream<element_t> taps[Points::size], Args... args) {
+        #pragma HLS INLINE
+        hls::stream<element_t, DEPTH> fifo(stencil_stage_names<STAGE>::fifo);
+        #pragma HLS STREAM variable=fifo depth=DEPTH
+        #pragma HLS BIND_STORAGE variable=fifo type=fifo impl=uram
+
+        DATAFLOW_REGION;
+        DATAFLOW_PROCESS(Chain::template tap<Points, STAGE>(in, fifo, taps, args...));
+        DATAFLOW_PROCESS(stencil_stage<Chain, Points, STAGE + 1>::run(fifo, taps, args...));
+    }
+};
+
+// Last stage: nothing follows, the forwarded copy is discarded
+template <class Chain, class Points, int STAGE, int DEPTH>
+struct stencil_stage<Chain, Points, STAGE, FIFO_IMPL_NONE, DEPTH> {
+    typedef typename Chain::element_t element_t;
+
+    template <class... Args>
+    static void run(hls::stream<element_t>& in, hls::stream<element_t> taps[Points::size], Args... args) {
+        #pragma HLS INLINE
+        hls::stream<element_t, 4> to_discard("to_discard");
+        #pragma HLS STREAM variable=to_discard depth=4
+
+        DATAFLOW_REGION;
+        DATAFLOW_PROCESS(Chain::template tap<Points, STAGE>(in, to_discard, taps, args...));
+        DATAFLOW_PROCESS(Chain::discard(to_discard, args...));
+    }
+};
+
+#endif
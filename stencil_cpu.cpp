@@ -0,0 +1,129 @@
+#include "stencil_cpu.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Column tile: three input rows of this width plus one output row stay in L1/L2
+// while a row band is swept top to bottom.
+const int TILE_COLUMNS = 2048;
+
+// Rows per unit of work handed to a thread
+const int MIN_BAND_ROWS = 8;
+
+static int cpu_threads = 0;
+
+void stencil_cpu_set_threads(int threads) {
+    cpu_threads = threads;
+}
+
+const char* stencil_cpu_isa() {
+#if defined(__AVX512F__)
+    return "avx512";
+#elif defined(__AVX2__)
+    return "avx2";
+#else
+    return "scalar";
+#endif
+}
+
+// One output pixel, with the operation order of compute_kernel / compute_golden
+static inline data_t stencil_point(const data_t* up, const data_t* mid, const data_t* down, int j) {
+    data_t a00 = mid[j];
+    data_t res_0 = a00 - mid[j - 1];
+    data_t res_1 = a00 - mid[j + 1];
+    data_t res_2 = a00 - up[j];
+    data_t res_3 = a00 - down[j];
+    return (res_0 * res_0) + (res_1 * res_1) + (res_2 * res_2) + (res_3 * res_3);
+}
+
+// Output row segment j = j_begin..j_end-1 (input columns) of one interior row
+static void stencil_row_segment(const data_t* up, const data_t* mid, const data_t* down,
+                                data_t* out, int j_begin, int j_end) {
+    int j = j_begin;
+
+#if defined(__AVX512F__)
+    for (; j + 16 <= j_end; j += 16) {
+        __m512 a00 = _mm512_loadu_ps(mid + j);
+        __m512 res_0 = _mm512_sub_ps(a00, _mm512_loadu_ps(mid + j - 1));
+        __m512 res_1 = _mm512_sub_ps(a00, _mm512_loadu_ps(mid + j + 1));
+        __m512 res_2 = _mm512_sub_ps(a00, _mm512_loadu_ps(up + j));
+        __m512 res_3 = _mm512_sub_ps(a00, _mm512_loadu_ps(down + j));
+        __m512 b_val = _mm512_add_ps(_mm512_mul_ps(res_0, res_0), _mm512_mul_ps(res_1, res_1));
+        b_val = _mm512_add_ps(b_val, _mm512_mul_ps(res_2, res_2));
+        b_val = _mm512_add_ps(b_val, _mm512_mul_ps(res_3, res_3));
+        _mm512_storeu_ps(out + j - 1, b_val);
+    }
+#endif
+
+#if defined(__AVX2__)
+    for (; j + 8 <= j_end; j += 8) {
+        __m256 a00 = _mm256_loadu_ps(mid + j);
+        __m256 res_0 = _mm256_sub_ps(a00, _mm256_loadu_ps(mid + j - 1));
+        __m256 res_1 = _mm256_sub_ps(a00, _mm256_loadu_ps(mid + j + 1));
+        __m256 res_2 = _mm256_sub_ps(a00, _mm256_loadu_ps(up + j));
+        __m256 res_3 = _mm256_sub_ps(a00, _mm256_loadu_ps(down + j));
+        __m256 b_val = _mm256_add_ps(_mm256_mul_ps(res_0, res_0), _mm256_mul_ps(res_1, res_1));
+        b_val = _mm256_add_ps(b_val, _mm256_mul_ps(res_2, res_2));
+        b_val = _mm256_add_ps(b_val, _mm256_mul_ps(res_3, res_3));
+        _mm256_storeu_ps(out + j - 1, b_val);
+    }
+#endif
+
+    for (; j < j_end; j++) {
+        out[j - 1] = stencil_point(up, mid, down, j);
+    }
+}
+
+// Interior rows i = row_begin..row_end-1, swept one column tile at a time
+static void stencil_band(const data_t* A, data_t* B, int columns, int row_begin, int row_end) {
+    int out_columns = columns - 2;
+    for (int tile = 1; tile < columns - 1; tile += TILE_COLUMNS) {
+        int tile_end = std::min(tile + TILE_COLUMNS, columns - 1);
+        for (int i = row_begin; i < row_end; i++) {
+            const data_t* mid = A + (size_t)i * columns;
+            stencil_row_segment(mid - columns, mid, mid + columns,
+                                B + (size_t)(i - 1) * out_columns, tile, tile_end);
+        }
+    }
+}
+
+void architecture_top_level_cpu(data_t* A_in_mem, data_t* B_out_mem,
+                                int rows, int columns) {
+    if (rows < 3 || columns < 3) return;
+
+    int interior_rows = rows - 2;
+    int threads = cpu_threads > 0 ? cpu_threads : (int)std::thread::hardware_concurrency();
+    threads = std::max(1, std::min(threads, (interior_rows + MIN_BAND_ROWS - 1) / MIN_BAND_ROWS));
+
+    if (threads == 1) {
+        stencil_band(A_in_mem, B_out_mem, columns, 1, rows - 1);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (int t = 0; t < threads; t++) {
+        int row_begin = 1 + (int)((long long)interior_rows * t / threads);
+        int row_end = 1 + (int)((long long)interior_rows * (t + 1) / threads);
+        workers.push_back(std::thread(stencil_band, A_in_mem, B_out_mem, columns, row_begin, row_end));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+}
+
+void stencil_cpu_reference(const data_t* A_in_mem, data_t* B_out_mem,
+                           int rows, int columns) {
+    int out = 0;
+    for (int i = 1; i < rows - 1; i++) {
+        const data_t* mid = A_in_mem + (size_t)i * columns;
+        for (int j = 1; j < columns - 1; j++) {
+            B_out_mem[out++] = stencil_point(mid - columns, mid, mid + columns, j);
+        }
+    }
+}
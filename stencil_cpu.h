@@ -0,0 +1,27 @@
+#ifndef STENCIL_CPU_H
+#define STENCIL_CPU_H
+
+// CPU backend of the 5-point stencil of Listing 1 (408):
+// B[i-1][j-1] = sum of (A[i][j] - n)^2 over the four neighbours n of A[i][j].
+// Same in/out layout as architecture_top_level at PARALLEL_FACTOR=1: A is a dense
+// rows x columns grid, B the dense (rows-2) x (columns-2) interior.
+
+typedef float data_t;
+
+// Drop-in replacement for the FPGA kernel on hosts without the card.
+// Cache-blocked, vectorized (AVX-512 / AVX2 / scalar, chosen at compile time)
+// and split over threads by row bands.
+void architecture_top_level_cpu(data_t* A_in_mem, data_t* B_out_mem,
+                                int rows, int columns);
+
+// Worker threads used by architecture_top_level_cpu (0 = hardware concurrency)
+void stencil_cpu_set_threads(int threads);
+
+// Plain scalar loop, the same as compute_golden in the testbenches
+void stencil_cpu_reference(const data_t* A_in_mem, data_t* B_out_mem,
+                           int rows, int columns);
+
+// Name of the SIMD path compiled in ("avx512", "avx2" or "scalar")
+const char* stencil_cpu_isa();
+
+#endif
@@ -0,0 +1,98 @@
+// Benchmark and check of the CPU backend (stencil_cpu.cpp) against the scalar
+// reference loop.
+//
+//   g++ -O3 -march=native -pthread stencil_cpu.cpp stencil_cpu_bench.cpp -o stencil_cpu_bench
+//   ./stencil_cpu_bench                      (default size sweep)
+//   ./stencil_cpu_bench rows columns [threads] [repetitions]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include "stencil_cpu.h"
+
+const int NUM_BENCH_SIZES = 4;
+const int BENCH_SIZES[NUM_BENCH_SIZES][2] = {
+    {16, 1024}, {1024, 1024}, {4096, 4096}, {2048, 8192}
+};
+
+typedef void (*stencil_fn)(data_t*, data_t*, int, int);
+
+static void reference_adapter(data_t* A, data_t* B, int rows, int columns) {
+    stencil_cpu_reference(A, B, rows, columns);
+}
+
+// Best time in seconds over 'repetitions' runs
+static double time_runs(stencil_fn fn, data_t* A, data_t* B, int rows, int columns, int repetitions) {
+    double best = 1e30;
+    for (int r = 0; r < repetitions; r++) {
+        auto start = std::chrono::steady_clock::now();
+        fn(A, B, rows, columns);
+        auto stop = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(stop - start).count());
+    }
+    return best;
+}
+
+// Returns the number of mismatches
+static int run_bench(int rows, int columns, int repetitions) {
+    size_t total_elements = (size_t)rows * columns;
+    size_t kernel_iterations = (size_t)(rows - 2) * (columns - 2);
+
+    std::vector<data_t> A(total_elements);
+    std::vector<data_t> B_ref(kernel_iterations);
+    std::vector<data_t> B_cpu(kernel_iterations);
+    for (size_t i = 0; i < total_elements; i++) {
+        A[i] = (data_t)(i % 256);
+    }
+
+    double t_ref = time_runs(reference_adapter, A.data(), B_ref.data(), rows, columns, repetitions);
+    double t_cpu = time_runs(architecture_top_level_cpu, A.data(), B_cpu.data(), rows, columns, repetitions);
+
+    int errors = 0;
+    double max_abs = 0.0;
+    for (size_t i = 0; i < kernel_iterations; i++) {
+        double diff = std::fabs((double)B_cpu[i] - (double)B_ref[i]);
+        max_abs = std::max(max_abs, diff);
+        if (diff > 0.001 * std::max(1.0, std::fabs((double)B_ref[i]))) {
+            errors++;
+            if (errors < 10) {
+                printf("  [ERROR] i=%zu CPU=%f Ref=%f\n", i, B_cpu[i], B_ref[i]);
+            }
+        }
+    }
+
+    // Bytes moved per call: A read once, B written once
+    double bytes = (double)(total_elements + kernel_iterations) * sizeof(data_t);
+    printf("%6d x %-6d  reference %8.3f ms %7.2f GB/s   %s %8.3f ms %7.2f GB/s   x%.1f   max|err| %g\n",
+           rows, columns,
+           t_ref * 1e3, bytes / t_ref / 1e9,
+           stencil_cpu_isa(), t_cpu * 1e3, bytes / t_cpu / 1e9,
+           t_ref / t_cpu, max_abs);
+    return errors;
+}
+
+int main(int argc, char** argv) {
+    int repetitions = 5;
+    if (argc > 3) stencil_cpu_set_threads(atoi(argv[3]));
+    if (argc > 4) repetitions = atoi(argv[4]);
+
+    printf("[BENCH] CPU stencil backend (%s)\n", stencil_cpu_isa());
+
+    int errors = 0;
+    if (argc > 2) {
+        errors += run_bench(atoi(argv[1]), atoi(argv[2]), repetitions);
+    } else {
+        for (int t = 0; t < NUM_BENCH_SIZES; t++) {
+            errors += run_bench(BENCH_SIZES[t][0], BENCH_SIZES[t][1], repetitions);
+        }
+    }
+
+    if (errors == 0) {
+        printf("\n--- TEST PASSED ---\n");
+    } else {
+        printf("\n--- TEST FAILED: %d errors ---\n", errors);
+    }
+    return (errors == 0) ? 0 : 1;
+}
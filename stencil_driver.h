@@ -0,0 +1,104 @@
+#ifndef STENCIL_DRIVER_H
+#define STENCIL_DRIVER_H
+
+// Host side of the HLS top levels, shared by cong_testbench.cpp,
+// stencil_bench.cpp and stencil_host.cpp: the AXI word layout, the frame limit,
+// the error tolerance of each DATA_FORMAT and, for the drivers that can be built
+// against several top levels, the target checks. Built with the kernel's -D
+// flags. stencil_bench.cpp and stencil_host.cpp define DRIVER_TARGET (from
+// BENCH_TARGET / HOST_TARGET) before including it; the testbench drives the
+// memory-mapped top level with every option and leaves it undefined.
+
+#include <stddef.h>
+#include <vector>
+#include "ap_int.h"
+#include "pixel_format.h"
+#include "stencil_golden.h"
+
+// Drivers keep every grid in float; pixels are converted to and from the
+// kernel's DATA_FORMAT only when they are packed into AXI words.
+typedef float data_t;
+
+// Must match the kernel build (-DPARALLEL_FACTOR=P)
+#ifndef PARALLEL_FACTOR
+#define PARALLEL_FACTOR 1
+#endif
+
+#ifndef TIME_STEPS
+#define TIME_STEPS 1
+#endif
+
+const int P = PARALLEL_FACTOR;
+const int DATA_WIDTH = active_format::WIDTH;
+typedef ap_uint<DATA_WIDTH * PARALLEL_FACTOR> mem_word_t;
+
+// Widest grid of the FPGA top levels, which size their line buffers for it
+const int MAX_COLUMNS = 1024;
+
+// Tolerance of a pixel against stencil_golden.h, relative to max(1, |ref|) and
+// sized for the format's rounding of A, B and the intermediate steps
+#if DATA_FORMAT == DATA_FORMAT_FLOAT || DATA_FORMAT == DATA_FORMAT_FIXED
+const double TOLERANCE = 1e-3;
+#elif DATA_FORMAT == DATA_FORMAT_HALF
+const double TOLERANCE = 2e-3;
+#else
+const double TOLERANCE = 1e-2;
+#endif
+
+// A float as the kernel sees it once stored in DATA_FORMAT
+inline float round_to_format(float value) {
+    return active_format::to_float(active_format::from_float(value));
+}
+
+// Pack floats into P-pixel AXI words of DATA_FORMAT pixels (pixel k in bits W*k+W-1..W*k)
+inline void pack_words(const data_t* values, size_t count, mem_word_t* words) {
+    for (size_t i = 0; i < count; i++) {
+        int l = i % P;
+        ap_uint<DATA_WIDTH> bits = active_format::to_bits(active_format::from_float(values[i]));
+        words[i / P].range(DATA_WIDTH * l + DATA_WIDTH - 1, DATA_WIDTH * l) = bits;
+    }
+}
+
+inline void unpack_words(const mem_word_t* words, size_t count, data_t* values) {
+    for (size_t i = 0; i < count; i++) {
+        int l = i % P;
+        ap_uint<DATA_WIDTH> bits = words[i / P].range(DATA_WIDTH * l + DATA_WIDTH - 1, DATA_WIDTH * l);
+        values[i] = active_format::to_float(active_format::from_bits(bits));
+    }
+}
+
+inline void pack_words(const std::vector<data_t>& values, std::vector<mem_word_t>& words) {
+    pack_words(values.data(), values.size(), words.data());
+}
+
+inline void unpack_words(const std::vector<mem_word_t>& words, std::vector<data_t>& values) {
+    unpack_words(words.data(), values.size(), values.data());
+}
+
+// --- TARGETS ---
+// Top level a driver is built against:
+//   TARGET_MEMORY  first_try_cong.cpp, any PARALLEL_FACTOR, DATA_FORMAT,
+//                  STENCIL_SHAPE, TIME_STEPS and STENCIL_ENGINE
+//   TARGET_STREAM  cong_no_lcs.cpp, float 5-point
+//   TARGET_CPU     stencil_cpu.cpp, float 5-point (stencil_host.cpp only)
+#define TARGET_MEMORY 0
+#define TARGET_STREAM 1
+#define TARGET_CPU 2
+
+#ifdef DRIVER_TARGET
+#if DRIVER_TARGET != TARGET_MEMORY
+#if DATA_FORMAT != DATA_FORMAT_FLOAT || STENCIL_SHAPE != 5 || TIME_STEPS != 1 || PARALLEL_FACTOR != 1
+#error "the stream and cpu targets are float, 5-point, one time step, one pixel per clock"
+#endif
+#elif defined(ENABLE_STATS) && ENABLE_STATS || defined(ENABLE_PERF_COUNTERS) && ENABLE_PERF_COUNTERS || \
+      defined(ENABLE_ROW_PROGRESS) && ENABLE_ROW_PROGRESS
+#error "the drivers call the plain architecture_top_level (ENABLE_STATS=0, ENABLE_PERF_COUNTERS=0, ENABLE_ROW_PROGRESS=0)"
+#endif
+
+inline const char* target_name() {
+    return (DRIVER_TARGET == TARGET_STREAM) ? "stream" :
+           (DRIVER_TARGET == TARGET_CPU) ? "cpu" : "memory";
+}
+#endif
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef STENCIL_GOLDEN_H
+#define STENCIL_GOLDEN_H
+
+// Software reference shared by cong_testbench.cpp, cong_no_lcs_tb.cpp and
+// stencil_bench.cpp: the STENCIL_SHAPE point tables, the golden stencil, the
+// input distributions of the benchmark and the error statistics of a run.
+// Grids are row-major float vectors, as in the testbenches.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#ifndef STENCIL_SHAPE
+#define STENCIL_SHAPE 5
+#endif
+
+// Stencil points (di, dj) in the same order as the kernel's stencil_points lists
+#if STENCIL_SHAPE == 5
+const int NUM_POINTS = 5;
+const int STENCIL_OFFSETS[NUM_POINTS][2] = {
+    {0,-1}, {0,1}, {-1,0}, {1,0}, {0,0}
+};
+#elif STENCIL_SHAPE == 9
+const int NUM_POINTS = 9;
+const int STENCIL_OFFSETS[NUM_POINTS][2] = {
+    {0,-1}, {0,1}, {-1,0}, {1,0}, {-1,-1}, {-1,1}, {1,-1}, {1,1}, {0,0}
+};
+#elif STENCIL_SHAPE == 13
+const int NUM_POINTS = 13;
+const int STENCIL_OFFSETS[NUM_POINTS][2] = {
+    {0,-1}, {0,1}, {-1,0}, {1,0}, {0,-2}, {0,2}, {-2,0}, {2,0},
+    {-1,-1}, {-1,1}, {1,-1}, {1,1}, {0,0}
+};
+#elif STENCIL_SHAPE == 6
+const int NUM_POINTS = 6;
+const int STENCIL_OFFSETS[NUM_POINTS][2] = {
+    {0,-1}, {0,-2}, {-1,0}, {-2,0}, {1,1}, {0,0}
+};
+#else
+#error "STENCIL_SHAPE must be 5, 9, 13 or 6"
+#endif
+
+// How far the stencil reaches up/down/left/right of B[i][j]
+struct halo_t {
+    int top, bottom, left, right;
+};
+
+inline halo_t stencil_halo() {
+    halo_t h = {0, 0, 0, 0};
+    for (int k = 0; k < NUM_POINTS; k++) {
+        h.top = std::max(h.top, -STENCIL_OFFSETS[k][0]);
+        h.bottom = std::max(h.bottom, STENCIL_OFFSETS[k][0]);
+        h.left = std::max(h.left, -STENCIL_OFFSETS[k][1]);
+        h.right = std::max(h.right, STENCIL_OFFSETS[k][1]);
+    }
+    return h;
+}
+
+// One step over the valid region: B[i][j] = sum of (A[i][j] - A[i+di][j+dj])^2,
+// summed in STENCIL_OFFSETS order like the kernel. B is (rows - top - bottom) x
+// (columns - left - right).
+inline void golden_stencil(const std::vector<float>& A, std::vector<float>& B,
+                           int rows, int columns) {
+    halo_t h = stencil_halo();
+    B.clear();
+    B.reserve((size_t)(rows - h.top - h.bottom) * (columns - h.left - h.right));
+    for (int i = h.top; i < rows - h.bottom; i++) {
+        for (int j = h.left; j < columns - h.right; j++) {
+            float a00 = A[(size_t)i * columns + j];
+            float b_val = 0;
+            for (int k = 0; k < NUM_POINTS; k++) {
+                int di = STENCIL_OFFSETS[k][0];
+                int dj = STENCIL_OFFSETS[k][1];
+                if (di == 0 && dj == 0) continue;
+                float res = a00 - A[(size_t)(i + di) * columns + (j + dj)];
+                b_val += res * res;
+            }
+            B.push_back(b_val);
+        }
+    }
+}
+
+// 'steps' steps, each on the previous step's output (temporal blocking). With
+// 'round', the output of every step but the last goes through it first, as the
+// kernel stores the intermediate grids in its pixel format.
+inline void golden_stencil_steps(const std::vector<float>& A, std::vector<float>& B,
+                                 int rows, int columns, int steps,
+                                 float (*round)(float) = NULL) {
+    halo_t h = stencil_halo();
+    std::vector<float> in = A;
+    for (int t = 0; t < steps; t++) {
+        int step_rows = rows - t * (h.top + h.bottom);
+        int step_columns = columns - t * (h.left + h.right);
+        golden_stencil(in, B, step_rows, step_columns);
+        if (round != NULL && t + 1 < steps) {
+            for (size_t i = 0; i < B.size(); i++) {
+                B[i] = round(B[i]);
+            }
+        }
+        in.swap(B);
+    }
+    B.swap(in);
+}
+
+// Input distributions of the benchmark. Every pixel is level * scale with a
+// level in [0, 256); the caller picks 'scale' so that B stays inside the
+// range of its pixel format.
+//   ramp      (i + seed) % 256, the pattern of the testbenches
+//   random    uniform, reproducible from 'seed'
+//   constant  128 everywhere, so B is exactly 0
+//   denormal  random, meant for a scale that puts the pixels below the
+//             format's smallest normal value
+//   large     random, meant for a scale close to the format's limit
+enum input_distribution {
+    INPUT_RAMP,
+    INPUT_RANDOM,
+    INPUT_CONSTANT,
+    INPUT_DENORMAL,
+    INPUT_LARGE,
+    NUM_INPUT_DISTRIBUTIONS
+};
+
+inline const char* input_distribution_name(int distribution) {
+    switch (distribution) {
+    case INPUT_RAMP:     return "ramp";
+    case INPUT_RANDOM:   return "random";
+    case INPUT_CONSTANT: return "constant";
+    case INPUT_DENORMAL: return "denormal";
+    case INPUT_LARGE:    return "large";
+    default:             return "unknown";
+    }
+}
+
+inline void fill_input(std::vector<float>& values, int distribution, float scale, int seed = 0) {
+    uint32_t state = 2463534242u + (uint32_t)seed;
+    for (size_t i = 0; i < values.size(); i++) {
+        float level;
+        if (distribution == INPUT_RAMP) {
+            level = (float)((i + seed) % 256);
+        } else if (distribution == INPUT_CONSTANT) {
+            level = 128.0f;
+        } else {
+            // xorshift32, 24 random bits -> [0, 256)
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            level = (float)(state >> 8) * (256.0f / 16777216.0f);
+        }
+        values[i] = level * scale;
+    }
+}
+
+// Error of a kernel result against the golden one. The relative error is
+// taken over nonzero references; a mismatch is an absolute error above
+// tolerance * max(1, |ref|), the check of the testbenches.
+struct error_stats {
+    double max_abs_error = 0.0;
+    double max_rel_error = 0.0;
+    long mismatches = 0;
+};
+
+inline error_stats compare_outputs(const std::vector<float>& result, const std::vector<float>& golden,
+                                   double tolerance) {
+    error_stats stats;
+    for (size_t i = 0; i < golden.size(); i++) {
+        // Equal infinities (an overflow in both) are no error, a NaN always is
+        double abs_error = 0.0;
+        if (result[i] != golden[i]) {
+            abs_error = std::abs((double)result[i] - (double)golden[i]);
+            if (std::isnan(abs_error)) {
+                abs_error = HUGE_VAL;
+            }
+        }
+        stats.max_abs_error = std::max(stats.max_abs_error, abs_error);
+        if (golden[i] != 0) {
+            stats.max_rel_error = std::max(stats.max_rel_error, abs_error / std::abs((double)golden[i]));
+        }
+        if (abs_error > tolerance * std::max(1.0, std::abs((double)golden[i]))) {
+            stats.mismatches++;
+        }
+    }
+    return stats;
+}
+
+#endif
@@ -0,0 +1,440 @@
+// Streaming host driver: runs a grid file of any height through one stencil top
+// level in row bands, so that grids far larger than RAM (and than MAX_ROWS) can
+// be processed from disk. The input and output files are memory mapped; band k
+// covers B rows [k * band_rows, (k + 1) * band_rows) and reads the A rows under
+// them plus the TIME_STEPS halo rows below, so consecutive bands overlap by the
+// halo. Bands are double buffered: while the top level computes band k, an I/O
+// thread writes band k - 1 to the output mapping and reads band k + 1 from the
+// input mapping. Pages of both files are dropped once no later band needs them,
+// which keeps the resident set at a few bands whatever the grid size. Prints the
+// wall time, the throughput, how much of the I/O was hidden and the peak RSS.
+//
+// Built against one top level, with the same -D flags as the kernel:
+//   memory mapped (default)  first_try_cong.cpp, any PARALLEL_FACTOR, DATA_FORMAT,
+//                            STENCIL_SHAPE, TIME_STEPS and STENCIL_ENGINE
+//   stream                   cong_no_lcs.cpp (-DHOST_TARGET=1), float 5-point
+//   cpu                      stencil_cpu.cpp (-DHOST_TARGET=2), float 5-point; reads
+//                            A from and writes B to the mappings directly
+//
+//   g++ -O2 -pthread -I$XILINX_HLS/include -DPARALLEL_FACTOR=4 first_try_cong.cpp stencil_host.cpp -o stencil_host
+//   g++ -O3 -march=native -pthread -DHOST_TARGET=2 stencil_cpu.cpp stencil_host.cpp -o stencil_host_cpu
+//   ./stencil_host input output [--rows n --columns n] [--band-rows n] [--check]
+//
+// Grid files are row-major float32, either NumPy .npy (2-D, '<f4', C order,
+// recognised by its magic) or raw, which needs --rows and --columns. The output
+// is written in the input's format: B, (rows - halo) x (columns - halo), the
+// crop of the kernel. With --check every band is also compared with
+// stencil_golden.h, still one band at a time.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "ap_int.h"
+#include "hls_stream.h"
+
+// Top level driven: TARGET_MEMORY (default), TARGET_STREAM or TARGET_CPU of
+// stencil_driver.h
+#ifndef HOST_TARGET
+#define HOST_TARGET 0
+#endif
+#define DRIVER_TARGET HOST_TARGET
+#include "stencil_driver.h"
+
+// The CPU backend has no line buffers, so no column limit
+#if HOST_TARGET == TARGET_CPU
+const long COLUMN_LIMIT = 1L << 30;
+#else
+const long COLUMN_LIMIT = MAX_COLUMNS;
+#endif
+
+// Prototype of the top level driven
+#if HOST_TARGET == TARGET_STREAM
+void architecture_top_level(hls::stream<data_t>& A_in, hls::stream<data_t>& B_out,
+                            int rows, int columns);
+#elif HOST_TARGET == TARGET_CPU
+void architecture_top_level_cpu(data_t* A_in_mem, data_t* B_out_mem,
+                                int rows, int columns);
+#else
+void architecture_top_level(mem_word_t* A_in_mem, mem_word_t* B_out_mem,
+                            int rows, int columns, int boundary, int output_pitch);
+#endif
+
+// --- GRID FILES ---
+// A mapped grid: 'data' points 'header_bytes' into the mapping of the file
+struct grid_file {
+    int fd = -1;
+    unsigned char* map = NULL;
+    size_t map_bytes = 0;
+    size_t header_bytes = 0;
+    long rows = 0;
+    long columns = 0;
+    bool npy = false;
+    size_t released = 0; // bytes at the start of the mapping already dropped
+
+    data_t* data() const { return (data_t*)(map + header_bytes); }
+    data_t* row(long r) const { return data() + r * columns; }
+};
+
+static const char NPY_MAGIC[] = "\x93NUMPY";
+const int NPY_MAGIC_BYTES = 6;
+const int NPY_ALIGNMENT = 64;
+
+// Value of 'key' in the header dictionary of a .npy file, "" if absent
+static std::string npy_field(const std::string& header, const char* key) {
+    size_t at = header.find(std::string("'") + key + "'");
+    if (at == std::string::npos) return "";
+    at = header.find(':', at);
+    if (at == std::string::npos) return "";
+    at = header.find_first_not_of(' ', at + 1);
+    size_t end = (header[at] == '(') ? header.find(')', at) + 1 : header.find_first_of(",}", at);
+    return header.substr(at, end - at);
+}
+
+// Parses the header of a 2-D float32 C-order .npy file
+static bool parse_npy(grid_file& grid) {
+    if (grid.map_bytes < 10) return false;
+    int version = grid.map[NPY_MAGIC_BYTES];
+    size_t length_bytes = (version == 1) ? 2 : 4;
+    size_t length = 0;
+    for (size_t b = 0; b < length_bytes; b++) {
+        length |= (size_t)grid.map[8 + b] << (8 * b);
+    }
+    grid.header_bytes = 8 + length_bytes + length;
+    if (grid.header_bytes > grid.map_bytes) return false;
+    std::string header((const char*)grid.map + 8 + length_bytes, length);
+    if (npy_field(header, "descr") != "'<f4'" || npy_field(header, "fortran_order") != "False") {
+        printf("[HOST] Only C-order little-endian float32 .npy grids are supported\n");
+        return false;
+    }
+    if (sscanf(npy_field(header, "shape").c_str(), "(%ld, %ld)", &grid.rows, &grid.columns) != 2) {
+        printf("[HOST] Only 2-D .npy grids are supported\n");
+        return false;
+    }
+    grid.npy = true;
+    return true;
+}
+
+// Maps 'path' read-only; a .npy file carries its size, a raw one gets rows x columns
+static bool open_input(const char* path, long rows, long columns, grid_file& grid) {
+    grid.fd = open(path, O_RDONLY);
+    struct stat st;
+    if (grid.fd < 0 || fstat(grid.fd, &st) != 0 || st.st_size == 0) {
+        printf("[HOST] Cannot open %s\n", path);
+        return false;
+    }
+    grid.map_bytes = st.st_size;
+    grid.map = (unsigned char*)mmap(NULL, grid.map_bytes, PROT_READ, MAP_PRIVATE, grid.fd, 0);
+    if (grid.map == MAP_FAILED) {
+        printf("[HOST] Cannot map %s\n", path);
+        return false;
+    }
+    madvise(grid.map, grid.map_bytes, MADV_SEQUENTIAL);
+    if (memcmp(grid.map, NPY_MAGIC, NPY_MAGIC_BYTES) == 0) {
+        if (!parse_npy(grid)) return false;
+    } else {
+        grid.rows = rows;
+        grid.columns = columns;
+        if (rows <= 0 || columns <= 0) {
+            printf("[HOST] %s is a raw grid: give its --rows and --columns\n", path);
+            return false;
+        }
+    }
+    if (grid.header_bytes + (size_t)grid.rows * grid.columns * sizeof(data_t) > grid.map_bytes) {
+        printf("[HOST] %s is smaller than a %ld x %ld grid\n", path, grid.rows, grid.columns);
+        return false;
+    }
+    return true;
+}
+
+// Creates 'path' at its final size, writes the .npy header if 'npy' and maps it
+// shared, so that B written to the mapping goes to the file
+static bool create_output(const char* path, long rows, long columns, bool npy, grid_file& grid) {
+    std::string header;
+    if (npy) {
+        char dict[128];
+        snprintf(dict, sizeof(dict), "{'descr': '<f4', 'fortran_order': False, 'shape': (%ld, %ld), }",
+                 rows, columns);
+        header = dict;
+        size_t unpadded = 10 + header.size() + 1;
+        header.append((NPY_ALIGNMENT - unpadded % NPY_ALIGNMENT) % NPY_ALIGNMENT, ' ');
+        header += '\n';
+        size_t length = header.size();
+        header = std::string(NPY_MAGIC, NPY_MAGIC_BYTES) + '\x01' + '\x00' +
+                 (char)(length & 0xFF) + (char)(length >> 8) + header;
+    }
+    grid.rows = rows;
+    grid.columns = columns;
+    grid.npy = npy;
+    grid.header_bytes = header.size();
+    grid.map_bytes = grid.header_bytes + (size_t)rows * columns * sizeof(data_t);
+    grid.fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (grid.fd < 0 || ftruncate(grid.fd, grid.map_bytes) != 0) {
+        printf("[HOST] Cannot create %s\n", path);
+        return false;
+    }
+    grid.map = (unsigned char*)mmap(NULL, grid.map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, grid.fd, 0);
+    if (grid.map == MAP_FAILED) {
+        printf("[HOST] Cannot map %s\n", path);
+        return false;
+    }
+    memcpy(grid.map, header.data(), header.size());
+    return true;
+}
+
+// Drops the pages of the mapping below byte 'end' from the resident set: clean
+// input pages are read again from the page cache if touched, dirty output pages
+// are written back first
+static void release_pages(grid_file& grid, size_t end, bool dirty) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    end = end / page * page;
+    if (end <= grid.released) return;
+    if (dirty) msync(grid.map + grid.released, end - grid.released, MS_ASYNC);
+    madvise(grid.map + grid.released, end - grid.released, MADV_DONTNEED);
+    grid.released = end;
+}
+
+static void close_grid(grid_file& grid) {
+    if (grid.map != NULL && grid.map != MAP_FAILED) munmap(grid.map, grid.map_bytes);
+    if (grid.fd >= 0) close(grid.fd);
+}
+
+// --- BANDS ---
+// One of the two buffers of the pipeline: B rows [first_row, first_row + rows)
+// and the A words (or stream) of rows [first_row, first_row + rows + halo)
+struct band_slot {
+    long first_row = 0;
+    int rows = 0;
+#if HOST_TARGET == TARGET_MEMORY
+    std::vector<mem_word_t> A_words;
+    std::vector<mem_word_t> B_words;
+#elif HOST_TARGET == TARGET_STREAM
+    hls::stream<data_t> A_in;
+    hls::stream<data_t> B_out;
+#endif
+};
+
+struct band_plan {
+    long output_rows;
+    int output_columns;
+    int halo_rows;
+    int halo_columns;
+    int band_rows;
+    long bands;
+};
+
+static void prefetch(const grid_file& grid, long first_row, long rows) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t begin = (grid.header_bytes + first_row * grid.columns * sizeof(data_t)) / page * page;
+    size_t end = std::min(grid.map_bytes, grid.header_bytes + (first_row + rows) * grid.columns * sizeof(data_t));
+    madvise(grid.map + begin, end - begin, MADV_WILLNEED);
+}
+
+// Reads band k of A into 'slot' (the CPU target reads the mapping itself, the
+// band is only paged in)
+static void load_band(const grid_file& in, const band_plan& plan, long k, band_slot& slot) {
+    slot.first_row = k * plan.band_rows;
+    slot.rows = (int)std::min<long>(plan.band_rows, plan.output_rows - slot.first_row);
+    long input_rows = slot.rows + plan.halo_rows;
+    const data_t* A = in.row(slot.first_row);
+    size_t pixels = (size_t)input_rows * in.columns;
+    prefetch(in, slot.first_row, input_rows);
+#if HOST_TARGET == TARGET_MEMORY
+    slot.A_words.assign((pixels + P - 1) / P, 0);
+    pack_words(A, pixels, slot.A_words.data());
+    slot.B_words.assign(((size_t)slot.rows * plan.output_columns + P - 1) / P, 0);
+#elif HOST_TARGET == TARGET_STREAM
+    for (size_t i = 0; i < pixels; i++) {
+        slot.A_in.write(A[i]);
+    }
+#else
+    volatile data_t sink = 0;
+    size_t page_pixels = sysconf(_SC_PAGESIZE) / sizeof(data_t);
+    for (size_t i = 0; i < pixels; i += page_pixels) {
+        sink = sink + A[i];
+    }
+#endif
+}
+
+// Runs the top level on the band in 'slot'
+static void compute_band(const grid_file& in, grid_file& out, const band_plan& plan, band_slot& slot) {
+    int input_rows = slot.rows + plan.halo_rows;
+    int columns = (int)in.columns;
+#if HOST_TARGET == TARGET_MEMORY
+    (void)out;
+    architecture_top_level(slot.A_words.data(), slot.B_words.data(), input_rows, columns, 0, 0);
+#elif HOST_TARGET == TARGET_STREAM
+    (void)out;
+    architecture_top_level(slot.A_in, slot.B_out, input_rows, columns);
+#else
+    architecture_top_level_cpu(in.row(slot.first_row), out.row(slot.first_row), input_rows, columns);
+#endif
+}
+
+// Writes B of the band in 'slot' to the output mapping
+static void store_band(grid_file& out, const band_plan& plan, band_slot& slot) {
+    data_t* B = out.row(slot.first_row);
+    size_t pixels = (size_t)slot.rows * plan.output_columns;
+#if HOST_TARGET == TARGET_MEMORY
+    unpack_words(slot.B_words.data(), pixels, B);
+#elif HOST_TARGET == TARGET_STREAM
+    for (size_t i = 0; i < pixels; i++) {
+        B[i] = slot.B_out.read();
+    }
+#else
+    (void)B;
+    (void)pixels;
+#endif
+}
+
+// Drops the pages of both files that no band after the one in 'slot' needs
+static void release_band(grid_file& in, grid_file& out, const band_slot& slot) {
+    long next_row = slot.first_row + slot.rows;
+    release_pages(in, in.header_bytes + next_row * in.columns * sizeof(data_t), false);
+    release_pages(out, out.header_bytes + next_row * out.columns * sizeof(data_t), true);
+}
+
+// --- CHECK ---
+// Compares B of the band with stencil_golden.h on the same A rows
+static void check_band(const grid_file& in, const grid_file& out, const band_plan& plan,
+                       const band_slot& slot, error_stats& total) {
+    int input_rows = slot.rows + plan.halo_rows;
+    const data_t* A = in.row(slot.first_row);
+    std::vector<data_t> A_band(A, A + (size_t)input_rows * in.columns);
+    for (size_t i = 0; i < A_band.size(); i++) {
+        A_band[i] = round_to_format(A_band[i]);
+    }
+    std::vector<data_t> golden;
+    golden_stencil_steps(A_band, golden, input_rows, (int)in.columns, TIME_STEPS, round_to_format);
+    const data_t* B = out.row(slot.first_row);
+    std::vector<data_t> B_band(B, B + golden.size());
+    error_stats errors = compare_outputs(B_band, golden, TOLERANCE);
+    total.max_abs_error = std::max(total.max_abs_error, errors.max_abs_error);
+    total.max_rel_error = std::max(total.max_rel_error, errors.max_rel_error);
+    total.mismatches += errors.mismatches;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    const char* paths[2] = {NULL, NULL};
+    int num_paths = 0;
+    long rows = 0;
+    long columns = 0;
+    // One top level call per band; the top levels take any number of rows
+    // (their MAX_ROWS is a trip count, see the valid runtime sizes there)
+    int band_rows = 256;
+    bool check = false;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--rows") == 0 && a + 1 < argc) {
+            rows = atol(argv[++a]);
+        } else if (strcmp(argv[a], "--columns") == 0 && a + 1 < argc) {
+            columns = atol(argv[++a]);
+        } else if (strcmp(argv[a], "--band-rows") == 0 && a + 1 < argc) {
+            band_rows = std::max(1, atoi(argv[++a]));
+        } else if (strcmp(argv[a], "--check") == 0) {
+            check = true;
+        } else if (argv[a][0] != '-' && num_paths < 2) {
+            paths[num_paths++] = argv[a];
+        } else {
+            num_paths = 0;
+            break;
+        }
+    }
+    if (num_paths != 2) {
+        printf("usage: %s input output [--rows n --columns n] [--band-rows n] [--check]\n", argv[0]);
+        return 2;
+    }
+
+    grid_file in;
+    grid_file out;
+    if (!open_input(paths[0], rows, columns, in)) return 2;
+
+    halo_t h = stencil_halo();
+    band_plan plan;
+    plan.halo_rows = TIME_STEPS * (h.top + h.bottom);
+    plan.halo_columns = TIME_STEPS * (h.left + h.right);
+    plan.output_rows = in.rows - plan.halo_rows;
+    plan.output_columns = (int)(in.columns - plan.halo_columns);
+    plan.band_rows = band_rows;
+    if (plan.output_rows < 1 || plan.output_columns < 1 || in.columns > COLUMN_LIMIT) {
+        printf("[HOST] A %ld x %ld grid is outside the kernel's frame limits (columns <= %ld)\n",
+               in.rows, in.columns, COLUMN_LIMIT);
+        return 2;
+    }
+    plan.bands = (plan.output_rows + band_rows - 1) / band_rows;
+    if (!create_output(paths[1], plan.output_rows, plan.output_columns, in.npy, out)) return 2;
+
+    printf("[HOST] %s target, %d pixels per word, %d time steps\n", target_name(), P, TIME_STEPS);
+    printf("[HOST] %s: %ld x %ld %s grid, %ld bands of %d rows overlapping by %d\n",
+           paths[0], in.rows, in.columns, in.npy ? "npy" : "raw", plan.bands, band_rows, plan.halo_rows);
+
+    // Double buffering: compute band k on this thread while the I/O thread
+    // stores band k - 1 and loads band k + 1, both in the other slot
+    band_slot slots[2];
+    error_stats errors;
+    double compute_seconds = 0.0;
+    double io_seconds = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    load_band(in, plan, 0, slots[0]);
+    double first_load_seconds = seconds_since(start);
+    for (long k = 0; k < plan.bands; k++) {
+        band_slot& current = slots[k % 2];
+        band_slot& other = slots[(k + 1) % 2];
+        double band_io_seconds = 0.0;
+        std::thread io([&]() {
+            auto io_start = std::chrono::steady_clock::now();
+            if (k > 0) {
+                store_band(out, plan, other);
+                if (check) check_band(in, out, plan, other, errors);
+                release_band(in, out, other);
+            }
+            if (k + 1 < plan.bands) load_band(in, plan, k + 1, other);
+            band_io_seconds = seconds_since(io_start);
+        });
+        auto compute_start = std::chrono::steady_clock::now();
+        compute_band(in, out, plan, current);
+        compute_seconds += seconds_since(compute_start);
+        io.join();
+        io_seconds += band_io_seconds;
+    }
+    auto last_start = std::chrono::steady_clock::now();
+    band_slot& last = slots[(plan.bands - 1) % 2];
+    store_band(out, plan, last);
+    if (check) check_band(in, out, plan, last, errors);
+    release_band(in, out, last);
+    msync(out.map, out.map_bytes, MS_SYNC);
+    io_seconds += first_load_seconds + seconds_since(last_start);
+    double wall_seconds = seconds_since(start);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double in_bytes = (double)in.rows * in.columns * sizeof(data_t);
+    double out_bytes = (double)plan.output_rows * plan.output_columns * sizeof(data_t);
+    printf("[HOST] %s: %ld x %d B written in %.3f s\n", paths[1], plan.output_rows, plan.output_columns, wall_seconds);
+    printf("[HOST] %.3g px/s, %.1f MB/s in + out\n",
+           (double)in.rows * in.columns / wall_seconds, (in_bytes + out_bytes) / wall_seconds / 1e6);
+    printf("[HOST] compute %.3f s, file I/O %.3f s (%.0f%% hidden behind compute)\n",
+           compute_seconds, io_seconds,
+           io_seconds > 0 ? 100.0 * std::max(0.0, 1.0 - (wall_seconds - compute_seconds) / io_seconds) : 100.0);
+    printf("[HOST] peak RSS %.1f MB for %.1f MB of grids\n", usage.ru_maxrss / 1024.0, (in_bytes + out_bytes) / 1e6);
+    if (check) {
+        printf("[HOST] check: max|err| %g, max rel %g, %ld mismatches\n",
+               errors.max_abs_error, errors.max_rel_error, errors.mismatches);
+    }
+
+    close_grid(in);
+    close_grid(out);
+    return (check && errors.mismatches != 0) ? 1 : 0;
+}
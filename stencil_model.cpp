@@ -0,0 +1,837 @@
+// Cycle-approximate model of the dataflow network of architecture_top_level
+// (first_try_cong.cpp): load_input, TIME_STEPS copies of the stencil_compute
+// network and store_output, with the same streams and depths. Every process
+// is an II=1 pipeline that moves at most one word per cycle when its inputs
+// hold a word and its outputs have room; a word becomes visible to the reader
+// 'latency' + 1 cycles after it was written. Runs in milliseconds instead of a
+// cosim_design, so FIFO depths and PARALLEL_FACTOR can be explored before
+// synthesis. Predicts:
+//   - the start-up skew (first B word) that fifo_00 / fifo_03 introduce,
+//   - total latency and the steady-state throughput of the store,
+//   - deadlock, with the stream every stuck process waits on,
+//   - the highest occupancy of every stream, and with --sweep-fifos the
+//     smallest depth of each chain FIFO that neither deadlocks nor adds latency.
+// Pipeline depths, the m_axi latencies and the row overhead of load_padded
+// are estimates (see MODEL LATENCIES); cosim_design stays the reference.
+//
+//   g++ -O2 stencil_model.cpp -o stencil_model
+//   ./stencil_model [rows columns] [--parallel P] [--shape 5|9|13|6] [--steps T]
+//                   [--engine chain|linebuffer] [--format 0-3] [--boundary 0-4]
+//                   [--pitch pixels] [--max-columns n] [--fifo stage=depth]
+//                   [--tap-depth n] [--stream-depth n] [--read-latency n]
+//                   [--write-latency n] [--compute-latency n] [--clock-ns t]
+//                   [--sweep-fifos] [--sweep-parallel]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// --- CONFIGURATION ---
+// The build macros of first_try_cong.cpp become runtime options here.
+enum engine_t { ENGINE_CHAIN = 0, ENGINE_LINE_BUFFER = 1 };
+
+struct model_config {
+    int rows = 16;
+    int columns = 1024;
+    int parallel = 1;            // PARALLEL_FACTOR
+    int shape = 5;               // STENCIL_SHAPE
+    int steps = 1;               // TIME_STEPS
+    int engine = ENGINE_CHAIN;   // STENCIL_ENGINE
+    int format = 0;              // DATA_FORMAT
+    int boundary = 0;            // runtime 'boundary' (0 = crop)
+    int output_pitch = 0;        // runtime 'output_pitch' (0 = dense)
+    int max_columns = 1024;      // MAX_COLUMNS, sizes the chain FIFOs
+    int tap_depth = 4;           // taps, s_to_f, to_discard, step_out
+    int stream_depth = 128;      // input_stream, output_stream
+    std::vector<int> fifo_depths; // chain FIFO depth per stage, 0 = kernel sizing
+    int read_latency = 64;       // gmem0 request to data
+    int write_latency = 64;      // last gmem1 write to response
+    int compute_latency = -1;    // compute_kernel pipeline depth, -1 = by format
+    double clock_ns = 4.5;       // create_clock -period of run_hls.tcl
+};
+
+// --- STENCIL SHAPES ---
+// Same points as the kernel's stencil_points lists (the order does not matter
+// here: the chain stages follow the linear offsets)
+struct shape_t {
+    int shape;
+    int size;
+    int offsets[13][2];
+};
+
+const int NUM_SHAPES = 4;
+const shape_t SHAPES[NUM_SHAPES] = {
+    {5, 5, {{0,-1}, {0,1}, {-1,0}, {1,0}, {0,0}}},
+    {9, 9, {{0,-1}, {0,1}, {-1,0}, {1,0}, {-1,-1}, {-1,1}, {1,-1}, {1,1}, {0,0}}},
+    {13, 13, {{0,-1}, {0,1}, {-1,0}, {1,0}, {0,-2}, {0,2}, {-2,0}, {2,0},
+              {-1,-1}, {-1,1}, {1,-1}, {1,1}, {0,0}}},
+    {6, 6, {{0,-1}, {0,-2}, {-1,0}, {-2,0}, {1,1}, {0,0}}},
+};
+
+const shape_t* find_shape(int shape) {
+    for (int s = 0; s < NUM_SHAPES; s++) {
+        if (SHAPES[s].shape == shape) return &SHAPES[s];
+    }
+    return NULL;
+}
+
+struct halo_t {
+    int top, bottom, left, right;
+};
+
+halo_t shape_halo(const shape_t& points) {
+    halo_t h = {0, 0, 0, 0};
+    for (int k = 0; k < points.size; k++) {
+        h.top = std::max(h.top, -points.offsets[k][0]);
+        h.bottom = std::max(h.bottom, points.offsets[k][0]);
+        h.left = std::max(h.left, -points.offsets[k][1]);
+        h.right = std::max(h.right, points.offsets[k][1]);
+    }
+    return h;
+}
+
+int words_for(int n, int P) {
+    return (n + P - 1) / P;
+}
+
+// Point tapped by chain stage s: the s-th largest linear offset di*columns+dj,
+// as stencil_point_at_stage (stencil_chain.h)
+std::vector<int> stage_order(const shape_t& points, int columns) {
+    std::vector<int> order(points.size);
+    for (int k = 0; k < points.size; k++) order[k] = k;
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return points.offsets[a][0] * columns + points.offsets[a][1] >
+               points.offsets[b][0] * columns + points.offsets[b][1];
+    });
+    return order;
+}
+
+// Words between the taps of stage s and s+1 for a 'columns' wide grid, at
+// least 2: the depth stencil_fifo_depth gives fifo_<s> for columns = MAX_COLUMNS
+int stage_gap_words(const shape_t& points, const std::vector<int>& order, int s, int columns, int P) {
+    int a = order[s];
+    int b = order[s + 1];
+    int pixels = (points.offsets[a][0] - points.offsets[b][0]) * columns +
+                 (points.offsets[a][1] - points.offsets[b][1]);
+    return std::max(2, words_for(pixels, P));
+}
+
+// --- MODEL LATENCIES ---
+// Cycles from reading a word to writing its result, estimated for the 4.5 ns
+// clock of run_hls.tcl. compute_kernel subtracts, squares and adds the
+// squared differences as a balanced tree (config_compile
+// -unsafe_math_optimizations), plus the widen/narrow of the pixel format.
+const int SPLITTER_LATENCY = 1;
+const int FILTER_LATENCY = 1;
+const int LINE_BUFFER_LATENCY = 2;
+const int STORE_LATENCY = 1;
+
+int compute_latency(const model_config& config, int points) {
+    if (config.compute_latency >= 0) return config.compute_latency;
+    int levels = 0;
+    while ((1 << levels) < points - 1) levels++;
+    switch (config.format) {
+    case 1:  return 1 + 2 + levels * 1;          // ap_fixed: sub, DSP multiply, adds
+    case 2:  return 1 + 4 + 3 + levels * 4 + 2;  // half: widen, float, narrow
+    case 3:  return 4 + 3 + levels * 4 + 1;      // bfloat16: float, narrow
+    default: return 4 + 3 + levels * 4;          // float: fsub, fmul, fadd tree
+    }
+}
+
+// --- STREAMS ---
+// A word issued at cycle t by a process of pipeline depth L is written at t + L
+// and readable from t + L + 1 on. The producer sees the stream full once 'depth'
+// written words wait in it; words still inside its pipeline do not count, they
+// are held in the pipeline registers as in the synthesised II=1 loop.
+struct stream_t {
+    std::string name;
+    int depth;
+    std::deque<long> words;  // cycle each word becomes readable, oldest first
+    int max_occupancy = 0;
+    int required = 0;        // chain FIFOs: gap of the runtime grid (0 = none)
+
+    stream_t(const std::string& n, int d) : name(n), depth(d) {}
+
+    int occupancy(long cycle) const {
+        int in_flight = 0;
+        for (auto w = words.rbegin(); w != words.rend() && *w > cycle; ++w) in_flight++;
+        return (int)words.size() - in_flight;
+    }
+    bool readable(long cycle) const { return !words.empty() && words.front() <= cycle; }
+    bool writable(long cycle) const { return occupancy(cycle) < depth; }
+    void write(long visible) { words.push_back(visible); }
+    void read(long cycle) {
+        max_occupancy = std::max(max_occupancy, std::min(depth, occupancy(cycle)));
+        words.pop_front();
+    }
+};
+
+// --- PROCESSES ---
+enum process_kind {
+    LOAD_DENSE, LOAD_PADDED, SPLITTER, FILTER, SINK, COMPUTE, LINE_BUFFER,
+    STORE_DENSE, STORE_PITCHED
+};
+
+struct process_t {
+    std::string name;
+    process_kind kind;
+    std::vector<int> in;
+    std::vector<int> out;
+    long trips = 0;      // pipelined iterations, one per cycle at best
+    int latency = 1;
+    int P = 1;
+
+    // Grid walked by FILTER / LINE_BUFFER / LOAD_PADDED / STORE_PITCHED
+    int rows = 0;
+    int columns = 0;
+    int row_start = 0, row_end = 0, col_start = 0, col_end = 0; // FILTER domain
+    int i = 0, j = 0;    // (i, j) of lane 0 (FILTER), (r, c) (LINE_BUFFER)
+    int count = 0;       // FILTER pending pixels, STORE_PITCHED lane of the word read
+    long in_words = 0;   // FILTER words read so far, of in_trips
+    long in_trips = 0;
+
+    // LOAD_PADDED: row pr of the padded grid, step k of its 'row_steps'
+    std::vector<int> fill_words;
+    int pr = 0, k = 0, row_steps = 0, lane = 0, pc = 0, padded_columns = 0;
+    int row_overhead = 0;
+
+    // State and statistics
+    long done = 0;
+    long resume = 0;     // no iteration before this cycle (row overhead)
+    long first = -1;
+    long finish = -1;
+    long starved = 0;    // cycles waiting for an input word
+    long blocked = 0;    // cycles waiting for room in an output
+    int waiting = -1;    // stream the last stall waited on
+    bool waiting_full = false;
+    std::vector<long> marks; // STORE: cycles at 10 % and 90 % of the trips
+};
+
+// Streams the current iteration of p reads and writes
+void iteration_streams(const process_t& p, std::vector<int>& reads, std::vector<int>& writes) {
+    reads.clear();
+    writes.clear();
+    switch (p.kind) {
+    case LOAD_DENSE:
+        writes.push_back(p.out[0]);
+        break;
+    case LOAD_PADDED: {
+        int send_pixels = (p.pr > 0) ? p.padded_columns : 0;
+        bool last_row = p.pr == p.rows;
+        bool sending = p.pc < send_pixels;
+        if (sending && (p.lane == p.P - 1 || (last_row && p.pc == p.padded_columns - 1))) {
+            writes.push_back(p.out[0]);
+        }
+        break;
+    }
+    case SPLITTER:
+        reads.push_back(p.in[0]);
+        writes = p.out;
+        break;
+    case FILTER: {
+        if (p.in_words == p.in_trips) {
+            // Flush of the last, partially filled word
+            writes.push_back(p.out[0]);
+            break;
+        }
+        reads.push_back(p.in[0]);
+        int pos = p.count;
+        int i = p.i;
+        int j = p.j;
+        for (int l = 0; l < p.P; l++) {
+            if (i >= p.row_start && i <= p.row_end && j >= p.col_start && j <= p.col_end) pos++;
+            if (j == p.columns - 1) { j = 0; i++; } else { j++; }
+        }
+        if (pos >= p.P) writes.push_back(p.out[0]);
+        break;
+    }
+    case SINK:
+    case STORE_DENSE:
+        reads.push_back(p.in[0]);
+        break;
+    case COMPUTE:
+        reads = p.in;
+        writes.push_back(p.out[0]);
+        break;
+    case LINE_BUFFER:
+        reads.push_back(p.in[0]);
+        if (p.i >= 2 && p.j >= 2) writes = p.out;
+        break;
+    case STORE_PITCHED:
+        if (p.count == 0) reads.push_back(p.in[0]);
+        break;
+    }
+}
+
+// LOAD_PADDED: steps of padded row pr (row pr filled while row pr-1 is sent)
+int padded_row_steps(const process_t& p, int pr) {
+    int fill = (pr < p.rows) ? p.fill_words[pr] : 0;
+    int send = (pr > 0) ? p.padded_columns : 0;
+    return std::max(fill, send);
+}
+
+void start_padded_row(process_t& p, long cycle) {
+    while (p.pr <= p.rows && (p.row_steps = padded_row_steps(p, p.pr)) == 0) {
+        p.pr++;
+    }
+    p.k = 0;
+    p.pc = 0;
+    p.resume = cycle + 1 + p.row_overhead;
+}
+
+// Advances p past one iteration (its streams already read and written)
+void advance(process_t& p, long cycle) {
+    switch (p.kind) {
+    case LOAD_PADDED: {
+        int send_pixels = (p.pr > 0) ? p.padded_columns : 0;
+        bool last_row = p.pr == p.rows;
+        if (p.pc < send_pixels) {
+            bool flush = p.lane == p.P - 1 || (last_row && p.pc == p.padded_columns - 1);
+            p.lane = flush ? 0 : p.lane + 1;
+            p.pc++;
+        }
+        p.k++;
+        if (p.k == p.row_steps) {
+            p.pr++;
+            start_padded_row(p, cycle);
+        }
+        break;
+    }
+    case FILTER: {
+        if (p.in_words == p.in_trips) break; // flush
+        int pos = p.count;
+        for (int l = 0; l < p.P; l++) {
+            if (p.i >= p.row_start && p.i <= p.row_end && p.j >= p.col_start && p.j <= p.col_end) pos++;
+            if (p.j == p.columns - 1) { p.j = 0; p.i++; } else { p.j++; }
+        }
+        p.count = (pos >= p.P) ? pos - p.P : pos;
+        p.in_words++;
+        break;
+    }
+    case LINE_BUFFER:
+        if (p.j == p.columns - 1) { p.j = 0; p.i++; } else { p.j++; }
+        break;
+    case STORE_PITCHED:
+        p.count = (p.count == p.P - 1) ? 0 : p.count + 1;
+        break;
+    default:
+        break;
+    }
+}
+
+// --- NETWORK ---
+// With 'unbounded' every stream is deep enough never to fill: the latency that
+// the dependencies between the processes alone allow.
+const int UNBOUNDED_DEPTH = 1 << 30;
+
+struct network_t {
+    std::vector<stream_t> streams;
+    std::vector<process_t> processes;
+    int output_pixels = 0;
+    int chain_stages = 0;
+
+    bool unbounded = false;
+
+    int add_stream(const std::string& name, int depth) {
+        streams.push_back(stream_t(name, unbounded ? UNBOUNDED_DEPTH : std::max(1, depth)));
+        return (int)streams.size() - 1;
+    }
+    process_t& add_process(const std::string& name, process_kind kind, long trips, int latency, int P) {
+        process_t p;
+        p.name = name;
+        p.kind = kind;
+        p.trips = trips;
+        p.latency = latency;
+        p.P = P;
+        processes.push_back(p);
+        return processes.back();
+    }
+};
+
+// One stencil_compute on a rows x columns grid, reading stream 'in' and
+// writing stream 'out'
+void build_step(network_t& net, const model_config& config, const shape_t& points,
+                int step, int rows, int columns, int in, int out) {
+    const int P = config.parallel;
+    const int N = points.size;
+    halo_t h = shape_halo(points);
+    std::string prefix = (config.steps > 1) ? "step" + std::to_string(step) + "." : "";
+    int total_words = words_for(rows * columns, P);
+    int kernel_pixels = (rows - h.top - h.bottom) * (columns - h.left - h.right);
+
+    std::vector<int> taps(N);
+    for (int k = 0; k < N; k++) {
+        taps[k] = net.add_stream(prefix + "taps[" + std::to_string(k) + "]", config.tap_depth);
+    }
+
+    if (config.engine == ENGINE_LINE_BUFFER) {
+        process_t& lb = net.add_process(prefix + "line_buffer_stencil", LINE_BUFFER,
+                                        (long)rows * columns, LINE_BUFFER_LATENCY, P);
+        lb.in.push_back(in);
+        lb.out = taps;
+        lb.rows = rows;
+        lb.columns = columns;
+    } else {
+        std::vector<int> order = stage_order(points, config.max_columns);
+        std::vector<int> runtime_order = stage_order(points, columns);
+        int stage_in = in;
+        for (int s = 0; s < N; s++) {
+            char index[12];
+            snprintf(index, sizeof(index), "%02d", s);
+            int next;
+            if (s < N - 1) {
+                int depth = stage_gap_words(points, order, s, config.max_columns, P);
+                if (s < (int)config.fifo_depths.size() && config.fifo_depths[s] > 0) {
+                    depth = config.fifo_depths[s];
+                }
+                next = net.add_stream(prefix + "fifo_" + index, depth);
+                net.streams[next].required = stage_gap_words(points, runtime_order, s, columns, P);
+            } else {
+                next = net.add_stream(prefix + "to_discard", config.tap_depth);
+            }
+            int s_to_f = net.add_stream(prefix + "s_to_f_" + index, config.tap_depth);
+
+            process_t& splitter = net.add_process(prefix + "data_splitter_" + index, SPLITTER,
+                                                  total_words, SPLITTER_LATENCY, P);
+            splitter.in.push_back(stage_in);
+            splitter.out.push_back(next);
+            splitter.out.push_back(s_to_f);
+
+            int K = order[s];
+            int di = points.offsets[K][0];
+            int dj = points.offsets[K][1];
+            process_t& filter = net.add_process(prefix + "data_filter_" + index, FILTER,
+                                                total_words + (kernel_pixels % P ? 1 : 0),
+                                                FILTER_LATENCY, P);
+            filter.in.push_back(s_to_f);
+            filter.out.push_back(taps[K]);
+            filter.in_trips = total_words;
+            filter.rows = rows;
+            filter.columns = columns;
+            filter.row_start = h.top + di;
+            filter.row_end = rows - 1 - (h.bottom - di);
+            filter.col_start = h.left + dj;
+            filter.col_end = columns - 1 - (h.right - dj);
+            stage_in = next;
+        }
+        process_t& sink = net.add_process(prefix + "last_splitter_emptying", SINK,
+                                          total_words, 1, P);
+        sink.in.push_back(stage_in);
+        net.chain_stages = N - 1;
+    }
+
+    process_t& compute = net.add_process(prefix + "compute_kernel", COMPUTE,
+                                         words_for(kernel_pixels, P),
+                                         compute_latency(config, N), P);
+    compute.in = taps;
+    compute.out.push_back(out);
+}
+
+// Whole architecture_top_level: load_input, the cascade and store_output
+bool build_network(network_t& net, const model_config& config) {
+    const shape_t* points = find_shape(config.shape);
+    if (points == NULL) {
+        printf("[MODEL] Unknown stencil shape %d\n", config.shape);
+        return false;
+    }
+    const int P = config.parallel;
+    const int T = config.steps;
+    halo_t h = shape_halo(*points);
+    int halo_rows = h.top + h.bottom;
+    int halo_columns = h.left + h.right;
+    bool padded = config.boundary != 0;
+    int grid_rows = padded ? config.rows + T * halo_rows : config.rows;
+    int grid_columns = padded ? config.columns + T * halo_columns : config.columns;
+    int output_rows = grid_rows - T * halo_rows;
+    int output_columns = grid_columns - T * halo_columns;
+
+    if (output_rows < 1 || output_columns < 1) {
+        printf("[MODEL] Grid %d x %d is too small for %d steps of the %d-point stencil\n",
+               config.rows, config.columns, T, config.shape);
+        return false;
+    }
+    if (grid_columns > config.max_columns) {
+        printf("[MODEL] Grid %d columns wide exceeds MAX_COLUMNS = %d\n", grid_columns, config.max_columns);
+        return false;
+    }
+    if (config.engine == ENGINE_LINE_BUFFER &&
+        (P != 1 || h.top != 1 || h.bottom != 1 || h.left != 1 || h.right != 1)) {
+        printf("[MODEL] The line-buffer engine needs PARALLEL_FACTOR 1 and a 3x3 stencil\n");
+        return false;
+    }
+    if (config.output_pitch != 0 && (config.output_pitch % P != 0 || config.output_pitch < output_columns)) {
+        printf("[MODEL] output_pitch must be a multiple of %d and at least %d\n", P, output_columns);
+        return false;
+    }
+
+    int input_stream = net.add_stream("input_stream", config.stream_depth);
+    int output_stream = net.add_stream("output_stream", config.stream_depth);
+
+    if (!padded) {
+        process_t& load = net.add_process("load_input", LOAD_DENSE,
+                                          words_for(grid_rows * grid_columns, P),
+                                          config.read_latency, P);
+        load.out.push_back(input_stream);
+    } else {
+        // One padded pixel per clock; every row restarts the inner pipeline
+        process_t& load = net.add_process("load_input", LOAD_PADDED, 0, 2, P);
+        load.out.push_back(input_stream);
+        load.rows = grid_rows;
+        load.padded_columns = grid_columns;
+        load.row_overhead = config.read_latency;
+        for (int pr = 0; pr < grid_rows; pr++) {
+            int src = pr - T * h.top;
+            bool outside = src < 0 || src >= config.rows;
+            if (outside && config.boundary == 1) {
+                load.fill_words.push_back(0);
+            } else {
+                src = std::min(std::max(src, 0), config.rows - 1); // any row of A: same word count
+                int first_pixel = src * config.columns;
+                load.fill_words.push_back((first_pixel + config.columns - 1) / P - first_pixel / P + 1);
+            }
+        }
+        for (int pr = 0; pr <= grid_rows; pr++) load.trips += padded_row_steps(load, pr);
+        start_padded_row(load, -1);
+        load.resume = 0;
+    }
+
+    int step_in = input_stream;
+    for (int t = 0; t < T; t++) {
+        int step_out = (t == T - 1) ? output_stream
+                                    : net.add_stream("step" + std::to_string(t) + ".step_out", config.tap_depth);
+        build_step(net, config, *points, t, grid_rows - t * halo_rows, grid_columns - t * halo_columns,
+                   step_in, step_out);
+        step_in = step_out;
+    }
+
+    net.output_pixels = output_rows * output_columns;
+    if (config.output_pitch == 0) {
+        process_t& store = net.add_process("store_output", STORE_DENSE,
+                                           words_for(net.output_pixels, P), STORE_LATENCY, P);
+        store.in.push_back(output_stream);
+    } else {
+        process_t& store = net.add_process("store_output", STORE_PITCHED,
+                                           net.output_pixels, STORE_LATENCY, P);
+        store.in.push_back(output_stream);
+    }
+    return true;
+}
+
+// --- SIMULATION ---
+struct model_result {
+    bool deadlock = false;
+    long first_output = -1;      // cycle store_output reads its first word
+    long total_cycles = 0;       // until the last B write is acknowledged
+    double pixels_per_cycle = 0; // store throughput between 10 % and 90 % of B; 0 (n/a)
+                                 // when the store makes a single transfer
+};
+
+model_result simulate(network_t& net, const model_config& config) {
+    model_result result;
+    std::vector<process_t>& procs = net.processes;
+    std::vector<stream_t>& streams = net.streams;
+    process_t& store = procs.back();
+    long mark_10 = store.trips / 10;
+    long mark_90 = store.trips - store.trips / 10;
+
+    std::vector<char> fire(procs.size());
+    std::vector<int> reads;
+    std::vector<int> writes;
+    long cycle = 0;
+    while (true) {
+        // Decide every process on the state at the start of the cycle ...
+        bool all_done = true;
+        bool any_fired = false;
+        for (size_t n = 0; n < procs.size(); n++) {
+            process_t& p = procs[n];
+            fire[n] = 0;
+            if (p.done >= p.trips) continue;
+            all_done = false;
+            if (cycle < p.resume) {
+                p.starved++;
+                continue;
+            }
+            iteration_streams(p, reads, writes);
+            bool ok = true;
+            for (int s : reads) {
+                if (!streams[s].readable(cycle)) {
+                    ok = false;
+                    p.starved++;
+                    p.waiting = s;
+                    p.waiting_full = false;
+                    break;
+                }
+            }
+            if (ok) {
+                for (int s : writes) {
+                    if (!streams[s].writable(cycle)) {
+                        ok = false;
+                        p.blocked++;
+                        p.waiting = s;
+                        p.waiting_full = true;
+                        break;
+                    }
+                }
+            }
+            fire[n] = ok;
+            any_fired = any_fired || ok;
+        }
+        if (all_done) break;
+
+        // ... then move the words
+        for (size_t n = 0; n < procs.size(); n++) {
+            if (!fire[n]) continue;
+            process_t& p = procs[n];
+            iteration_streams(p, reads, writes);
+            for (int s : reads) streams[s].read(cycle);
+            for (int s : writes) streams[s].write(cycle + p.latency + 1);
+            advance(p, cycle);
+            if (p.first < 0) p.first = cycle;
+            p.done++;
+            if (p.done == p.trips) p.finish = cycle;
+            if (&p == &store) {
+                if (p.done == 1) result.first_output = cycle;
+                if (p.done == mark_10 || p.done == mark_90) p.marks.push_back(cycle);
+            }
+        }
+
+        // Nothing moved: jump to the next word that becomes visible or the next
+        // row restart; with neither the network is deadlocked
+        if (!any_fired) {
+            long next = -1;
+            for (const stream_t& s : streams) {
+                for (long w : s.words) {
+                    if (w > cycle && (next < 0 || w < next)) next = w;
+                }
+            }
+            for (const process_t& p : procs) {
+                if (p.done < p.trips && p.resume > cycle && (next < 0 || p.resume < next)) next = p.resume;
+            }
+            if (next < 0) {
+                result.deadlock = true;
+                result.total_cycles = cycle;
+                return result;
+            }
+            for (process_t& p : procs) {
+                if (p.done >= p.trips) continue;
+                if (p.waiting_full) p.blocked += next - cycle - 1;
+                else p.starved += next - cycle - 1;
+            }
+            cycle = next;
+            continue;
+        }
+        cycle++;
+    }
+
+    result.total_cycles = store.finish + 1 + config.write_latency;
+    if (store.marks.size() == 2 && store.marks[1] > store.marks[0]) {
+        double pixels_per_trip = (store.kind == STORE_DENSE) ? config.parallel : 1.0;
+        result.pixels_per_cycle = (mark_90 - mark_10) * pixels_per_trip / (store.marks[1] - store.marks[0]);
+    } else if (store.finish > store.first) {
+        result.pixels_per_cycle = (double)net.output_pixels / (store.finish - store.first + 1);
+    }
+    return result;
+}
+
+model_result run_model(const model_config& config, network_t* keep = NULL, bool unbounded = false) {
+    network_t net;
+    net.unbounded = unbounded;
+    model_result result;
+    if (!build_network(net, config)) {
+        result.deadlock = true;
+        return result;
+    }
+    result = simulate(net, config);
+    if (keep != NULL) *keep = net;
+    return result;
+}
+
+// --- REPORTS ---
+const char* format_name(int format) {
+    switch (format) {
+    case 1:  return "ap_fixed";
+    case 2:  return "half";
+    case 3:  return "bfloat16";
+    default: return "float";
+    }
+}
+
+void print_config(const model_config& config) {
+    printf("[MODEL] %d x %d, PARALLEL_FACTOR %d, %d-point stencil, %d time step(s), %s engine, %s, boundary %d, pitch %d\n",
+           config.rows, config.columns, config.parallel, config.shape, config.steps,
+           config.engine == ENGINE_LINE_BUFFER ? "line-buffer" : "chain", format_name(config.format),
+           config.boundary, config.output_pitch);
+}
+
+void print_report(const network_t& net, const model_result& result, const model_config& config) {
+    printf("\n  %-32s %9s %9s %9s %9s %9s %9s\n", "process", "trips", "done", "first", "finish", "starved", "blocked");
+    for (const process_t& p : net.processes) {
+        printf("  %-32s %9ld %9ld %9ld %9ld %9ld %9ld\n", p.name.c_str(), p.trips, p.done,
+               p.first, p.finish, p.starved, p.blocked);
+    }
+    printf("\n  %-32s %9s %9s %9s\n", "stream", "depth", "max occ.", "gap");
+    for (const stream_t& s : net.streams) {
+        if (s.required > 0) {
+            printf("  %-32s %9d %9d %9d%s\n", s.name.c_str(), s.depth, s.max_occupancy, s.required,
+                   s.depth < s.required ? "  < gap" : "");
+        } else {
+            printf("  %-32s %9d %9d %9s\n", s.name.c_str(), s.depth, s.max_occupancy, "-");
+        }
+    }
+    printf("\n");
+
+    if (result.deadlock) {
+        printf("  DEADLOCK at cycle %ld:\n", result.total_cycles);
+        for (const process_t& p : net.processes) {
+            if (p.done >= p.trips || p.waiting < 0) continue;
+            const stream_t& s = net.streams[p.waiting];
+            printf("    %-32s waits for %s %s (%d/%d words)\n", p.name.c_str(),
+                   p.waiting_full ? "room in" : "a word in", s.name.c_str(),
+                   std::min(s.depth, (int)s.words.size()), s.depth);
+        }
+        return;
+    }
+    double us = result.total_cycles * config.clock_ns * 1e-3;
+    printf("  first B word       : cycle %ld (start-up skew)\n", result.first_output);
+    printf("  total latency      : %ld cycles = %.2f us at %.2f ns\n",
+           result.total_cycles, us, config.clock_ns);
+    if (result.pixels_per_cycle > 0) {
+        printf("  steady throughput  : %.3f pixels/cycle = %.1f Mpixel/s\n",
+               result.pixels_per_cycle, result.pixels_per_cycle / config.clock_ns * 1e3);
+    } else {
+        printf("  steady throughput  : n/a (B is a single store transfer)\n");
+    }
+    printf("  overall            : %.1f Mpixel/s of B\n", net.output_pixels / us);
+}
+
+// Smallest depth of chain FIFO 'stage' (in every time step) for which the
+// network does not deadlock, and for which it is no slower than 'baseline'
+void sweep_fifo(const model_config& config, int stage, int start_depth, long baseline) {
+    int no_deadlock = -1;
+    int full_speed = -1;
+    for (int pass = 0; pass < 2; pass++) {
+        int lo = 1;
+        int hi = start_depth;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            model_config trial = config;
+            trial.fifo_depths.resize(std::max((int)trial.fifo_depths.size(), stage + 1), 0);
+            trial.fifo_depths[stage] = mid;
+            model_result r = run_model(trial);
+            bool ok = !r.deadlock && (pass == 0 || r.total_cycles <= baseline);
+            if (ok) hi = mid; else lo = mid + 1;
+        }
+        if (pass == 0) no_deadlock = lo; else full_speed = lo;
+    }
+    printf("  fifo_%02d   kernel depth %6d   no deadlock from %6d   full speed from %6d\n",
+           stage, start_depth, no_deadlock, full_speed);
+}
+
+int main(int argc, char** argv) {
+    model_config config;
+    bool sweep_fifos = false;
+    bool sweep_parallel = false;
+    std::vector<int> sizes;
+
+    for (int a = 1; a < argc; a++) {
+        const char* arg = argv[a];
+        const char* value = (a + 1 < argc) ? argv[a + 1] : NULL;
+        if (strcmp(arg, "--sweep-fifos") == 0) {
+            sweep_fifos = true;
+        } else if (strcmp(arg, "--sweep-parallel") == 0) {
+            sweep_parallel = true;
+        } else if (arg[0] != '-') {
+            sizes.push_back(atoi(arg));
+        } else if (value == NULL) {
+            printf("[MODEL] %s needs a value\n", arg);
+            return 2;
+        } else {
+            a++;
+            if (strcmp(arg, "--parallel") == 0) config.parallel = atoi(value);
+            else if (strcmp(arg, "--shape") == 0) config.shape = atoi(value);
+            else if (strcmp(arg, "--steps") == 0) config.steps = atoi(value);
+            else if (strcmp(arg, "--engine") == 0) config.engine = (strcmp(value, "linebuffer") == 0) ? ENGINE_LINE_BUFFER : ENGINE_CHAIN;
+            else if (strcmp(arg, "--format") == 0) config.format = atoi(value);
+            else if (strcmp(arg, "--boundary") == 0) config.boundary = atoi(value);
+            else if (strcmp(arg, "--pitch") == 0) config.output_pitch = atoi(value);
+            else if (strcmp(arg, "--max-columns") == 0) config.max_columns = atoi(value);
+            else if (strcmp(arg, "--tap-depth") == 0) config.tap_depth = atoi(value);
+            else if (strcmp(arg, "--stream-depth") == 0) config.stream_depth = atoi(value);
+            else if (strcmp(arg, "--read-latency") == 0) config.read_latency = atoi(value);
+            else if (strcmp(arg, "--write-latency") == 0) config.write_latency = atoi(value);
+            else if (strcmp(arg, "--compute-latency") == 0) config.compute_latency = atoi(value);
+            else if (strcmp(arg, "--clock-ns") == 0) config.clock_ns = atof(value);
+            else if (strcmp(arg, "--fifo") == 0) {
+                int stage = 0;
+                int depth = 0;
+                if (sscanf(value, "%d=%d", &stage, &depth) != 2 || stage < 0) {
+                    printf("[MODEL] --fifo takes stage=depth\n");
+                    return 2;
+                }
+                config.fifo_depths.resize(std::max((int)config.fifo_depths.size(), stage + 1), 0);
+                config.fifo_depths[stage] = depth;
+            } else {
+                printf("[MODEL] Unknown option %s\n", arg);
+                return 2;
+            }
+        }
+    }
+    if (sizes.size() >= 2) {
+        config.rows = sizes[0];
+        config.columns = sizes[1];
+    }
+
+    if (sweep_parallel) {
+        print_config(config);
+        printf("\n  %8s %12s %14s %16s %14s\n", "P", "first word", "latency", "pixels/cycle", "Mpixel/s");
+        const int factors[] = {1, 2, 4, 8, 16};
+        for (int P : factors) {
+            model_config trial = config;
+            trial.parallel = P;
+            if (trial.output_pitch % P != 0) trial.output_pitch = 0;
+            model_result r = run_model(trial);
+            if (r.deadlock) {
+                printf("  %8d %12s\n", P, "deadlock");
+            } else if (r.pixels_per_cycle > 0) {
+                printf("  %8d %12ld %14ld %16.3f %14.1f\n", P, r.first_output, r.total_cycles,
+                       r.pixels_per_cycle, r.pixels_per_cycle / config.clock_ns * 1e3);
+            } else {
+                printf("  %8d %12ld %14ld %16s %14s\n", P, r.first_output, r.total_cycles, "n/a", "n/a");
+            }
+        }
+        return 0;
+    }
+
+    print_config(config);
+    auto start = std::chrono::steady_clock::now();
+    network_t net;
+    model_result result = run_model(config, &net);
+    auto stop = std::chrono::steady_clock::now();
+    if (net.processes.empty()) return 2;
+    print_report(net, result, config);
+    model_result ideal = run_model(config, NULL, true);
+    if (!ideal.deadlock && ideal.pixels_per_cycle > 0) {
+        printf("  unbounded streams  : %ld cycles, %.3f pixels/cycle (what the stream depths cost)\n",
+               ideal.total_cycles, ideal.pixels_per_cycle);
+    } else if (!ideal.deadlock) {
+        printf("  unbounded streams  : %ld cycles (what the stream depths cost)\n", ideal.total_cycles);
+    }
+    printf("  model run time     : %.1f ms\n", std::chrono::duration<double>(stop - start).count() * 1e3);
+
+    if (sweep_fifos && !result.deadlock && config.engine == ENGINE_CHAIN) {
+        printf("\n[MODEL] Chain FIFO sizing for this grid (one FIFO varied at a time):\n");
+        const shape_t* points = find_shape(config.shape);
+        std::vector<int> order = stage_order(*points, config.max_columns);
+        for (int s = 0; s < net.chain_stages; s++) {
+            int depth = stage_gap_words(*points, order, s, config.max_columns, config.parallel);
+            if (s < (int)config.fifo_depths.size() && config.fifo_depths[s] > 0) depth = config.fifo_depths[s];
+            sweep_fifo(config, s, depth, result.total_cycles);
+        }
+    }
+    return result.deadlock ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+#ifndef STENCIL_PROGRESS_H
+#define STENCIL_PROGRESS_H
+
+// Host side of the ROW PROGRESS counter of architecture_top_level
+// (-DENABLE_ROW_PROGRESS=1): the kernel sets row_progress to r once rows 0..r-1
+// of B are in DRAM, so a consumer can take B band by band while the rest of the
+// frame is still computed.
+//
+//   stencil_progress_reset(counter);        // before the kernel is started
+//   ...start the kernel...
+//   if (stencil_wait_rows(counter, end, timeout_ms, sync, sync_arg)) {
+//       stencil_row_words span = stencil_rows_span(begin, end, ...);
+//       ...sync B words [span.first, span.first + span.count) and use them...
+//   }
+//
+// On a card the counter lives in device memory: pass a sync callback that
+// refreshes the host copy of the counter (e.g. an XRT bo.sync from the device
+// on its buffer) and sync the B span the same way before reading it. In
+// C-simulation the counter is shared memory and sync can be null.
+
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Called before every read of the counter; null when the counter is coherent
+typedef void (*stencil_sync_fn)(void* arg);
+
+// The kernel only raises the counter, so it is set to 0 before every launch
+inline void stencil_progress_reset(volatile int* counter) {
+    *counter = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+// Number of complete rows of B; rows below it may be read after this call
+inline int stencil_rows_done(const volatile int* counter) {
+    int rows = *counter;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return rows;
+}
+
+// True once rows [0, end_row) of B are complete
+inline bool stencil_rows_ready(const volatile int* counter, int end_row) {
+    return stencil_rows_done(counter) >= end_row;
+}
+
+// Waits until rows [0, end_row) of B are complete: spins a little, then yields
+// between reads. Returns false if timeout_ms (negative = no limit) runs out.
+inline bool stencil_wait_rows(const volatile int* counter, int end_row, int timeout_ms,
+                              stencil_sync_fn sync = nullptr, void* sync_arg = nullptr) {
+    const int SPIN_READS = 1024;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int reads = 0; ; reads++) {
+        if (sync) sync(sync_arg);
+        if (stencil_rows_ready(counter, end_row)) return true;
+        if (reads < SPIN_READS) continue;
+        if (timeout_ms >= 0 && std::chrono::steady_clock::now() - start >
+                                   std::chrono::milliseconds(timeout_ms)) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+}
+
+// Words of B holding rows [begin_row, end_row): dense when output_pitch is 0,
+// else one row every output_pitch pixels, parallel_factor pixels per word as
+// in the kernel. A dense word shared with the next row is included; it is
+// written with the first of the two rows.
+struct stencil_row_words {
+    size_t first;
+    size_t count;
+};
+
+inline stencil_row_words stencil_rows_span(int begin_row, int end_row, int output_columns,
+                                           int output_pitch, int parallel_factor) {
+    stencil_row_words span = {0, 0};
+    if (end_row <= begin_row) return span;
+    size_t p = (size_t)parallel_factor;
+    size_t end_word;
+    if (output_pitch == 0) {
+        span.first = (size_t)begin_row * output_columns / p;
+        end_word = ((size_t)end_row * output_columns + p - 1) / p;
+    } else {
+        size_t pitch_words = (size_t)output_pitch / p;
+        span.first = (size_t)begin_row * pitch_words;
+        end_word = (size_t)(end_row - 1) * pitch_words + (output_columns + p - 1) / p;
+    }
+    span.count = end_word - span.first;
+    return span;
+}
+
+#endif